@@ -39,13 +39,17 @@ Item {
     property bool load: false
     /// True if the photo is visible, either as preview, or as full version
     property bool isLoaded: preview.status === Image.Ready || fullImage.status === Image.Ready
+    /// Photos are served by the gallery's own thumbnail cache, videos by the thumbnailer
+    property string thumbnailUrl: mediaSource ?
+        (mediaSource.type === MediaSource.Video ? "image://thumbnailer/" : "image://thumbnail/") +
+        mediaSource.path + "?at=" + mediaSource.lastModified : ""
 
     Image {
         id: preview
         anchors.fill: parent
         asynchronous: true
         visible: fullImage.opacity < 1
-        source: load && mediaSource ? "image://thumbnailer/" + mediaSource.path + "?at=" + mediaSource.lastModified : ""
+        source: load && mediaSource ? thumbnailUrl : ""
         fillMode: fullImage.fillMode
         sourceSize.width: 256
     }
@@ -56,7 +60,7 @@ Item {
         cache: false
         fillMode: Image.PreserveAspectCrop
         source: (preview.status === Image.Ready && !isPreview) ?
-                "image://thumbnailer/" + mediaSource.path + "?at=" + mediaSource.lastModified : ""
+                thumbnailUrl : ""
 
         property int maxSize: Math.max(width, height)
         sourceSize.width: maxSize
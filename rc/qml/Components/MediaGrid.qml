@@ -85,11 +85,14 @@ GridView {
             radius: "medium"
             property bool isLoading: source.status === Image.Loading
  
-            backgroundColor: "black"
+            // Shows the average color of the photo until the thumbnail is
+            // loaded. Media without one get the invalid color, drawn black.
+            backgroundColor: mediaSource.placeholderColor
             sourceFillMode: UbuntuShape.PreserveAspectCrop
             source: Image {
                 id: thumbImage
-                source: "image://thumbnailer/" + mediaSource.path + "?at=" + mediaSource.lastModified
+                source: (mediaSource.type === MediaSource.Video ? "image://thumbnailer/" : "image://thumbnail/") +
+                        mediaSource.path + "?at=" + mediaSource.lastModified
                 asynchronous: true
                 fillMode: Image.PreserveAspectCrop
                 sourceSize {
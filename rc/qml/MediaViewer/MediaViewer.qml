@@ -331,6 +331,13 @@ Item {
                     });
                 }
             },
+            Action {
+                objectName: "rotateButton"
+                text: i18n.tr("Rotate")
+                iconName: "rotate-right"
+                enabled: galleryPhotoViewer.media.type === MediaSource.Photo
+                onTriggered: galleryPhotoViewer.media.rotateRight()
+            },
             Action {
                 objectName: "addButton"
                 text: i18n.tr("Add to album")
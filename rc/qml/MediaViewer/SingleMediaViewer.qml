@@ -33,6 +33,8 @@ Item {
     property bool showThumbnail: true
 
     property bool isVideo: mediaSource.type === MediaSource.Video
+    // RAW photos are shown through their embedded JPEG preview
+    property string photoProvider: mediaSource.raw ? "image://thumbnail/" : "image://photo/"
     property bool userInteracting: pinchInProgress || flickable.sizeScale != 1.0
     property bool fullyZoomed: flickable.sizeScale == zoomPinchArea.maximumZoom
     property bool fullyUnzoomed: flickable.sizeScale == zoomPinchArea.minimumZoom
@@ -143,10 +145,10 @@ Item {
                     target: mediaSource
                     onDataChanged: {
                         image.source = "";
-                        image.source = "image://photo/" + mediaSource.path
+                        image.source = photoProvider + mediaSource.path
 
                         highResolutionImage.source = "";
-                        highResolutionImage.source = "image://photo/" + mediaSource.path
+                        highResolutionImage.source = photoProvider + mediaSource.path
                     }
                 }
 
@@ -179,7 +181,7 @@ Item {
                         if (viewer.isVideo) {
                             return "image://thumbnailer/" + mediaSource.path
                         } else {
-                            return "image://photo/" + mediaSource.path
+                            return photoProvider + mediaSource.path
                         }
                     }
                     sourceSize {
@@ -199,7 +201,7 @@ Item {
                     asynchronous: true
                     cache: false
                     // Load image using the photo image provider to ensure EXIF orientation
-                    source: flickable.sizeScale > 1.0 ? "image://photo/" + mediaSource.path : ""
+                    source: flickable.sizeScale > 1.0 ? photoProvider + mediaSource.path : ""
                     sourceSize {
                         width: width
                         height: height
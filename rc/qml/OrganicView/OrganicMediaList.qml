@@ -177,7 +177,8 @@ Item {
                 sourceFillMode: UbuntuShape.PreserveAspectCrop
                 source: Image {
                     id: thumbImage
-                    source: "image://thumbnailer/" + model.mediaSource.path + "?at=" + model.mediaSource.lastModified
+                    source: (model.mediaSource.type === MediaSource.Video ? "image://thumbnailer/" : "image://thumbnail/") +
+                            model.mediaSource.path + "?at=" + model.mediaSource.lastModified
                     asynchronous: true
 
                     /* The SDK thumbnailer respects the freedesktop.org standard and uses 128 for the small
@@ -163,6 +163,13 @@ Page {
                 enabled: d.selection.selectedCount > 0
                 onTriggered: PopupUtils.open(deleteDialog, null);
             },
+            Action {
+                objectName: "rotateButton"
+                text: i18n.tr("Rotate")
+                iconName: "rotate-right"
+                enabled: d.selection.selectedPhotosCount > 0
+                onTriggered: d.selection.model.rotateSelectedMedia(false);
+            },
             Action {
                 objectName: "shareButton"
                 text: i18n.tr("Share")
@@ -0,0 +1,43 @@
+-- Directory table
+-- The directory of each media is stored only once. Paths end with a '/', so
+-- everything below a directory is one range of the path index.
+
+PRAGMA foreign_keys = OFF;
+
+CREATE TABLE DirectoryTable (
+  id INTEGER PRIMARY KEY,
+  path TEXT NOT NULL UNIQUE
+);
+
+INSERT OR IGNORE INTO DirectoryTable (path)
+  SELECT DISTINCT rtrim(filename, replace(filename, '/', '')) FROM MediaTable;
+
+-- Media table
+-- Replace the full filename by the directory and the name in the directory
+
+CREATE TABLE MediaTableNew (
+  id INTEGER PRIMARY KEY,
+  dir_id INTEGER NOT NULL REFERENCES DirectoryTable,
+  basename TEXT NOT NULL,
+  width INT,
+  height INT,
+  timestamp INT DEFAULT NULL,
+  exposure_time INT DEFAULT NULL,
+  original_orientation INT DEFAULT NULL,
+  filesize INT DEFAULT NULL
+);
+
+INSERT INTO MediaTableNew (id, dir_id, basename, width, height, timestamp,
+                           exposure_time, original_orientation, filesize)
+  SELECT m.id, d.id, substr(m.filename, length(d.path) + 1), m.width, m.height,
+         m.timestamp, m.exposure_time, m.original_orientation, m.filesize
+  FROM MediaTable m JOIN DirectoryTable d
+  ON d.path = rtrim(m.filename, replace(m.filename, '/', ''));
+
+DROP TABLE MediaTable;
+
+ALTER TABLE MediaTableNew RENAME TO MediaTable;
+
+CREATE INDEX MediaTableDirectoryIndex ON MediaTable(dir_id, basename);
+
+PRAGMA foreign_keys = ON;
@@ -0,0 +1,17 @@
+-- Media type
+-- Stores if a media is a photo (1) or a video (2), so the views can select
+-- and order the media of one type in SQL. Existing rows are set by the
+-- extension of their file.
+
+ALTER TABLE MediaTable ADD COLUMN media_type INT NOT NULL DEFAULT 1;
+
+UPDATE MediaTable SET media_type = 2 WHERE
+  lower(basename) LIKE '%.mp4' OR lower(basename) LIKE '%.m4v' OR
+  lower(basename) LIKE '%.3gp' OR lower(basename) LIKE '%.mov' OR
+  lower(basename) LIKE '%.avi' OR lower(basename) LIKE '%.mkv' OR
+  lower(basename) LIKE '%.webm' OR lower(basename) LIKE '%.ogv' OR
+  lower(basename) LIKE '%.mpg' OR lower(basename) LIKE '%.mpeg';
+
+CREATE INDEX MediaTableTypeExposureIndex ON MediaTable(media_type, exposure_time);
+
+CREATE INDEX MediaTableExposureIndex ON MediaTable(exposure_time);
@@ -0,0 +1,8 @@
+-- Content hash
+-- A hash of the size, the start and the end of the file, to recognize media
+-- that shows up under a new path. Existing rows have none, and are imported
+-- again when moved, like before.
+
+ALTER TABLE MediaTable ADD COLUMN content_hash BLOB DEFAULT NULL;
+
+CREATE INDEX MediaTableContentHashIndex ON MediaTable(content_hash);
@@ -0,0 +1,6 @@
+-- Placeholder color
+-- The average color of a photo, computed at import from the Exif thumbnail.
+-- It's shown until the thumbnail is loaded. Existing rows have none, until
+-- their file changes.
+
+ALTER TABLE MediaTable ADD COLUMN placeholder_color INTEGER DEFAULT NULL;
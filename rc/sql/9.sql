@@ -0,0 +1,8 @@
+-- Media/album relationship table
+-- A photo is in an album only once, so attaching can be done with
+-- INSERT OR IGNORE
+
+DELETE FROM MediaAlbumTable WHERE rowid NOT IN
+  (SELECT MIN(rowid) FROM MediaAlbumTable GROUP BY album_id, media_id);
+
+CREATE UNIQUE INDEX MediaAlbumTableUniqueIndex ON MediaAlbumTable(album_id, media_id);
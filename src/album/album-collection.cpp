@@ -37,27 +37,22 @@ AlbumCollection::AlbumCollection(MediaCollection *mediaCollection,
 {
     // Load existing albums from database.
     QList<Album*> album_list;
-    m_albumTable->getAlbums(&album_list);
+    QHash<qint64, QVector<qint64> > album_media;
+    m_albumTable->getAlbums(&album_list, &album_media);
     foreach (Album* a, album_list) {
         a->setAlbumTemplate(albumTemplate);
         add(a);
-        int saved_current_page = a->currentPage();
 
         // Link each album up with its photos.
         QSet<DataObject*> photos;
-        QList<qint64> photo_list;
         MediaSource *media;
-        m_albumTable->mediaForAlbum(a->id(), &photo_list);
-        foreach (qint64 mediaId, photo_list) {
+        foreach (qint64 mediaId, album_media.value(a->id())) {
             media = m_mediaCollection->mediaForId(mediaId);
             if (media)
                 photos.insert(media);
         }
 
-        a->attachMany(photos);
-
-        // After photos are attached, restore the current page.
-        a->setCurrentPage(saved_current_page);
+        a->loadMedia(photos);
 
         // If there are no photos in the album, mark it as closed.
         // This is needed for the case where the user exits the application while
@@ -154,11 +149,13 @@ void AlbumCollection::notifyContentsChanged(const QSet<DataObject*>* added,
             m_albumTable->addAlbum(album);
 
             // Add initial photos.
+            QList<qint64> mediaIds;
             foreach(DataObject* o, album->contained()->getAll()) {
                 MediaSource* media = qobject_cast<MediaSource*>(o);
                 Q_ASSERT(media != NULL);
-                m_albumTable->attachToAlbum(album->id(), media->id());
+                mediaIds.append(media->id());
             }
+            m_albumTable->attachMany(album->id(), mediaIds);
         }
     }
 
@@ -104,6 +104,8 @@ void Album::initInstance()
     m_populatedPagesCount = 0;
     m_contentPages = new SourceCollection(QString("Pages for ") + m_title);
     m_refreshingContainer = false;
+    m_loadingMedia = false;
+    m_pageLayoutPending = false;
     m_id = INVALID_ID;
     m_coverNickname = "default";
 
@@ -221,6 +223,8 @@ int Album::getPageForMediaSource(QVariant vmedia) const
     if (m_contentPages == NULL)
         return -1;
 
+    ensurePageLayout();
+
     int page_count = m_contentPages->count();
     for (int page_ctr = 0; page_ctr < page_count; page_ctr++) {
         AlbumPage* album_page = m_contentPages->getAtAsType<AlbumPage*>(page_ctr);
@@ -369,6 +373,7 @@ bool Album::isNewAlbum() const
  */
 int Album::totalPageCount() const
 {
+    ensurePageLayout();
     return m_contentPages->count() + PAGES_PER_COVER * 2;
 }
 
@@ -378,6 +383,7 @@ int Album::totalPageCount() const
  */
 int Album::contentPageCount() const
 {
+    ensurePageLayout();
     return m_contentPages->count();
 }
 
@@ -387,6 +393,7 @@ int Album::contentPageCount() const
  */
 int Album::populatedContentPageCount() const
 {
+    ensurePageLayout();
     return m_populatedPagesCount;
 }
 
@@ -405,6 +412,7 @@ int Album::firstContentPage() const
  */
 int Album::lastContentPage() const
 {
+    ensurePageLayout();
     return contentToAbsolutePage(m_contentPages->count() - 1);
 }
 
@@ -414,6 +422,7 @@ int Album::lastContentPage() const
  */
 int Album::lastPopulatedContentPage() const
 {
+    ensurePageLayout();
     return contentToAbsolutePage(m_populatedPagesCount - 1);
 }
 
@@ -534,6 +543,7 @@ void Album::setCoverNickname(QString name)
  */
 SourceCollection* Album::contentPages()
 {
+    ensurePageLayout();
     return (SourceCollection*) m_contentPages;
 }
 
@@ -544,6 +554,7 @@ SourceCollection* Album::contentPages()
  */
 AlbumPage* Album::getAlbumPage(int page) const
 {
+    ensurePageLayout();
     int content_page = absoluteToContentPage(page);
     return qobject_cast<AlbumPage*>(m_contentPages->getAt(content_page));
 }
@@ -566,12 +577,25 @@ void Album::setAlbumTable(AlbumTable *albumTable)
     m_albumTable = albumTable;
 }
 
+/*!
+ * \brief Album::loadMedia adds the media, that belong to this album according
+ * to the database. Laying out the pages is postponed until they are needed.
+ * \param media
+ */
+void Album::loadMedia(const QSet<DataObject*>& media)
+{
+    m_loadingMedia = true;
+    attachMany(media);
+    m_loadingMedia = false;
+}
+
 /*!
  * \brief Album::qmlPages
  * \return
  */
 QQmlListProperty<AlbumPage> Album::qmlPages()
 {
+    ensurePageLayout();
     return QQmlListProperty<AlbumPage>(this, m_allAlbumPages);
 }
 
@@ -661,28 +685,70 @@ void Album::notifyContainerContentsChanged(const QSet<DataObject*>* added,
 
     ContainerSource::notifyContainerContentsChanged(added, removed);
 
+    if (m_loadingMedia) {
+        // Nothing to store, the media was just read from the database
+        m_allMediaSources = CastListToType<DataObject*, MediaSource*>(contained()->getAll());
+        m_pageLayoutPending = true;
+        m_refreshingContainer = stashed_refreshing_container;
+        return;
+    }
+
     // Update database.
     // If the album isn't in the DB yet, ignore for now.
     if (id() != INVALID_ID) {
         if (added != NULL) {
+            QList<qint64> mediaIds;
             QSetIterator<DataObject*> i(*added);
             while (i.hasNext()) {
                 MediaSource* media = qobject_cast<MediaSource*>(i.next());
                 Q_ASSERT(media != NULL);
-                m_albumTable->attachToAlbum(id(), media->id());
+                mediaIds.append(media->id());
             }
+            m_albumTable->attachMany(id(), mediaIds);
         }
 
         if (removed != NULL) {
+            QList<qint64> mediaIds;
             QSetIterator<DataObject*> i(*removed);
             while (i.hasNext()) {
                 MediaSource* media = qobject_cast<MediaSource*>(i.next());
                 Q_ASSERT(media != NULL);
-                m_albumTable->detachFromAlbum(id(), media->id());
+                mediaIds.append(media->id());
             }
+            m_albumTable->detachMany(id(), mediaIds);
         }
     }
 
+    layoutPages(old_page_count, stashed_refreshing_container, true);
+}
+
+/*!
+ * \brief Album::ensurePageLayout lays out the pages, if that was postponed
+ * when loading the album. As nobody has seen the pages before, no change is
+ * notified.
+ */
+void Album::ensurePageLayout() const
+{
+    if (!m_pageLayoutPending)
+        return;
+
+    Album *self = const_cast<Album*>(this);
+    bool stashed_refreshing_container = m_refreshingContainer;
+    self->m_refreshingContainer = true;
+    self->layoutPages(m_contentPages->count(), true, false);
+    self->m_refreshingContainer = stashed_refreshing_container;
+}
+
+/*!
+ * \brief Album::layoutPages distributes the media of the album on the pages
+ * \param oldPageCount
+ * \param stashedRefreshingContainer
+ * \param notify
+ */
+void Album::layoutPages(int oldPageCount, bool stashedRefreshingContainer, bool notify)
+{
+    m_pageLayoutPending = false;
+
     // TODO: Can be smarter than this, but since we don't know how position(s)
     // in the contained sources list have now changed, need to reset and start
     // afresh
@@ -730,9 +796,10 @@ void Album::notifyContainerContentsChanged(const QSet<DataObject*>* added,
 
     // update QML lists and notify QML watchers
     m_allMediaSources = CastListToType<DataObject*, MediaSource*>(contained()->getAll());
-    emit albumContentsChanged();
+    if (notify)
+        emit albumContentsChanged();
 
-    m_refreshingContainer = stashed_refreshing_container;
+    m_refreshingContainer = stashedRefreshingContainer;
 
     // If there's no content, add the "add photos" page.
     if (containedCount() == 0)
@@ -747,13 +814,14 @@ void Album::notifyContainerContentsChanged(const QSet<DataObject*>* added,
     if (m_currentPage != stashed_current_page)
         notifyCurrentPageChanged();
 
-    if (m_contentPages->count() != old_page_count)
+    if (m_contentPages->count() != oldPageCount)
         notifyPageCountChanged();
 
     notifyContentPagesChanged();
     // TODO: Again, could be smart and verify the current page has actually
     // changed
-    notifyCurrentPageContentsChanged();
+    if (notify)
+        notifyCurrentPageContentsChanged();
 }
 
 /*!
@@ -151,6 +151,8 @@ public:
 
     void setAlbumTable(AlbumTable* albumTable);
 
+    void loadMedia(const QSet<DataObject*>& media);
+
 protected:
     virtual void destroySource(bool destroyBacking, bool asOrphan);
 
@@ -175,6 +177,8 @@ private slots:
 private:
     void initInstance();
     QSet<DataObject*> mediaList2ObjectSet(QVariant mediaList) const;
+    void layoutPages(int oldPageCount, bool stashedRefreshingContainer, bool notify);
+    void ensurePageLayout() const;
 
     AlbumTemplate *m_albumTemplate;
     QString m_title;
@@ -188,6 +192,8 @@ private:
     QList<MediaSource*> m_allMediaSources;
     QList<AlbumPage*> m_allAlbumPages;
     bool m_refreshingContainer;
+    bool m_loadingMedia;
+    bool m_pageLayoutPending;
     qint64 m_id;
     QString m_coverNickname;
     AlbumTable *m_albumTable;
@@ -19,10 +19,12 @@
 
 #include "album-table.h"
 #include "database.h"
+#include "database-writer.h"
 
 // album
 #include "album.h"
 
+#include <QMutexLocker>
 #include <QtSql>
 
 /*!
@@ -37,22 +39,33 @@ AlbumTable::AlbumTable(Database* db, QObject* parent)
 }
 
 /*!
- * \brief AlbumTable::get_albums returns a set of all albums
- * Returns a set of all getAlbums
+ * \brief AlbumTable::get_albums returns a set of all albums, together with
+ * the photos of each album. Everything is read with one query.
  * \param albumSet
+ * \param albumMedia gets the IDs of the photos for each album ID
  */
-void AlbumTable::getAlbums(QList<Album*>* albumSet)
+void AlbumTable::getAlbums(QList<Album*>* albumSet, QHash<qint64, QVector<qint64> >* albumMedia)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT id, title, subtitle, time_added, is_closed, current_page, "
-                  "cover_nickname FROM AlbumTable ORDER BY time_added DESC");
-    if (!query.exec())
+    QSqlQuery query = m_db->prepare("SELECT a.id, a.title, a.subtitle, a.time_added, a.is_closed, "
+                                    "a.current_page, a.cover_nickname, m.media_id "
+                                    "FROM AlbumTable a LEFT JOIN MediaAlbumTable m "
+                                    "ON m.album_id = a.id ORDER BY a.time_added DESC, a.id");
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
-    while (query.next()) {
+    qint64 last_id = INVALID_ID;
+    while (m_db->next(query)) {
         QDateTime timestamp;
 
         qint64 id = query.value(0).toLongLong();
+        if (!query.value(7).isNull())
+            (*albumMedia)[id].append(query.value(7).toLongLong());
+
+        // One row per photo, the album itself is created only once
+        if (id == last_id)
+            continue;
+        last_id = id;
+
         QString title = query.value(1).toString();
         QString subtitle = query.value(2).toString();
         timestamp.setMSecsSinceEpoch(query.value(3).toLongLong());
@@ -76,18 +89,18 @@ void AlbumTable::addAlbum(Album* album)
     if (album->id() != INVALID_ID)
         return; // Nothing to do here.
 
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("INSERT INTO AlbumTable (title, subtitle, time_added, is_closed, "
-                  "current_page, cover_nickname) "
-                  "VALUES (:title, :subtitle, :time_added, :is_closed, :page, "
-                  ":cover_nickname)");
+    QMutexLocker locker(m_db->writeLock());
+    QSqlQuery query = m_db->prepare("INSERT INTO AlbumTable (title, subtitle, time_added, is_closed, "
+                                    "current_page, cover_nickname) "
+                                    "VALUES (:title, :subtitle, :time_added, :is_closed, :page, "
+                                    ":cover_nickname)");
     query.bindValue(":title", album->title());
     query.bindValue(":subtitle", album->subtitle());
     query.bindValue(":time_added", album->creationDateTime().toMSecsSinceEpoch());
     query.bindValue(":is_closed", album->isClosed());
     query.bindValue(":page", album->currentPage());
     query.bindValue(":cover_nickname", album->coverNickname());
-    if (!query.exec())
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
     album->setId(query.lastInsertId().toLongLong());
@@ -102,86 +115,65 @@ void AlbumTable::removeAlbum(Album* album)
     if (album->id() == INVALID_ID)
         return; // Nothing to remove.
 
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("DELETE FROM AlbumTable WHERE id = :id");
+    QMutexLocker locker(m_db->writeLock());
+    QSqlQuery query = m_db->prepare("DELETE FROM AlbumTable WHERE id = :id");
     query.bindValue(":id", album->id());
-    if (!query.exec())
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
     album->setId(INVALID_ID);
 }
 
 /*!
- * \brief AlbumTable::isAttachedToAlbum check if a photo is attached to album
+ * \brief AlbumTable::attachMany adds photos to an album. Photos that are in
+ * the album already are skipped.
  * \param albumId
- * \param mediaId
+ * \param mediaIds
  */
-bool AlbumTable::isAttachedToAlbum(qint64 albumId, qint64 mediaId) const
+void AlbumTable::attachMany(qint64 albumId, const QList<qint64>& mediaIds)
 {
-    QSqlQuery query(*m_db->getDB());
-
-    query.prepare("SELECT COUNT(*) FROM MediaAlbumTable WHERE album_id = :album_id AND media_id = :media_id");
-    query.bindValue(":album_id", albumId);
-    query.bindValue(":media_id", mediaId);
-    if (!query.exec())
-        m_db->logSqlError(query);
-    else if (query.next() && (query.value(0).toInt() > 0))
-        return true;
-
-    return false;
+    executeForMany("INSERT OR IGNORE INTO MediaAlbumTable (album_id, media_id) "
+                   "VALUES (:album_id, :media_id)", albumId, mediaIds);
 }
 
 /*!
- * \brief AlbumTable::attachToAlbum adds a photo to an album.
+ * \brief AlbumTable::detachMany removes photos from an album.
  * \param albumId
- * \param mediaId
+ * \param mediaIds
  */
-void AlbumTable::attachToAlbum(qint64 albumId, qint64 mediaId)
+void AlbumTable::detachMany(qint64 albumId, const QList<qint64>& mediaIds)
 {
-    if (isAttachedToAlbum(albumId, mediaId))
-        return;
-
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("INSERT INTO MediaAlbumTable (album_id, media_id) "
-                  "VALUES (:album_id, :media_id)");
-    query.bindValue(":album_id", albumId);
-    query.bindValue(":media_id", mediaId);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    executeForMany("DELETE FROM MediaAlbumTable WHERE album_id = :album_id AND "
+                   "media_id = :media_id", albumId, mediaIds);
 }
 
 /*!
- * \brief AlbumTable::detachFromAlbum removes a photo from an album.
+ * \brief AlbumTable::executeForMany executes the statement once for every
+ * photo, all in one transaction
+ * \param sql
  * \param albumId
- * \param mediaId
+ * \param mediaIds
  */
-void AlbumTable::detachFromAlbum(qint64 albumId, qint64 mediaId)
+void AlbumTable::executeForMany(const QString& sql, qint64 albumId,
+                                const QList<qint64>& mediaIds)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("DELETE FROM MediaAlbumTable WHERE album_id = :album_id AND "
-                  "media_id = :media_id");
-    query.bindValue(":album_id", albumId);
-    query.bindValue(":media_id", mediaId);
-    if (!query.exec())
-        m_db->logSqlError(query);
-}
+    if (mediaIds.isEmpty())
+        return;
 
-/*!
- * \brief AlbumTable::mediaForAlbum returns a list of photos for an album.
- * \param albumId
- * \param list
- */
-void AlbumTable::mediaForAlbum(qint64 albumId, QList<qint64>* list) const
-{
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT media_id FROM MediaAlbumTable WHERE "
-                  "album_id = :album_id");
+    QMutexLocker locker(m_db->writeLock());
+    QSqlDatabase *db = m_db->getDB();
+    db->transaction();
+
+    QSqlQuery query = m_db->prepare(sql);
     query.bindValue(":album_id", albumId);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    foreach (qint64 mediaId, mediaIds) {
+        query.bindValue(":media_id", mediaId);
+        if (!m_db->exec(query))
+            m_db->logSqlError(query);
+    }
 
-    while (query.next())
-        list->append(query.value(0).toLongLong());
+    if (!db->commit())
+        qDebug() << "SQLite error: " << db->lastError();
 }
 
 /*!
@@ -191,13 +183,12 @@ void AlbumTable::mediaForAlbum(qint64 albumId, QList<qint64>* list) const
  */
 void AlbumTable::setIsClosed(qint64 albumId, bool isClosed)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE AlbumTable SET is_closed = :is_closed WHERE "
-                  "id = :album_id");
-    query.bindValue(":is_closed", isClosed);
-    query.bindValue(":album_id", albumId);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    QVariantMap values;
+    values.insert(":is_closed", isClosed);
+    values.insert(":album_id", albumId);
+    m_db->getWriter()->enqueue(QString("AlbumTable.is_closed/%1").arg(albumId),
+                               "UPDATE AlbumTable SET is_closed = :is_closed WHERE "
+                               "id = :album_id", values);
 }
 
 /*!
@@ -207,13 +198,12 @@ void AlbumTable::setIsClosed(qint64 albumId, bool isClosed)
  */
 void AlbumTable::setCurrentPage(qint64 albumId, int page)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE AlbumTable SET current_page = :page WHERE "
-                  "id = :album_id");
-    query.bindValue(":page", page);
-    query.bindValue(":album_id", albumId);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    QVariantMap values;
+    values.insert(":page", page);
+    values.insert(":album_id", albumId);
+    m_db->getWriter()->enqueue(QString("AlbumTable.current_page/%1").arg(albumId),
+                               "UPDATE AlbumTable SET current_page = :page WHERE "
+                               "id = :album_id", values);
 }
 
 /*!
@@ -223,13 +213,12 @@ void AlbumTable::setCurrentPage(qint64 albumId, int page)
  */
 void AlbumTable::setCoverNickname(qint64 albumId, QString coverNickname)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE AlbumTable SET cover_nickname = :cover_nickname WHERE "
-                  "id = :album_id");
-    query.bindValue(":cover_nickname", coverNickname);
-    query.bindValue(":album_id", albumId);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    QVariantMap values;
+    values.insert(":cover_nickname", coverNickname);
+    values.insert(":album_id", albumId);
+    m_db->getWriter()->enqueue(QString("AlbumTable.cover_nickname/%1").arg(albumId),
+                               "UPDATE AlbumTable SET cover_nickname = :cover_nickname WHERE "
+                               "id = :album_id", values);
 }
 
 /*!
@@ -239,13 +228,12 @@ void AlbumTable::setCoverNickname(qint64 albumId, QString coverNickname)
  */
 void AlbumTable::setTitle(qint64 albumId, QString title)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE AlbumTable SET title = :title WHERE "
-                  "id = :album_id");
-    query.bindValue(":title", title);
-    query.bindValue(":album_id", albumId);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    QVariantMap values;
+    values.insert(":title", title);
+    values.insert(":album_id", albumId);
+    m_db->getWriter()->enqueue(QString("AlbumTable.title/%1").arg(albumId),
+                               "UPDATE AlbumTable SET title = :title WHERE "
+                               "id = :album_id", values);
 }
 
 /*!
@@ -255,11 +243,10 @@ void AlbumTable::setTitle(qint64 albumId, QString title)
  */
 void AlbumTable::setSubtitle(qint64 albumId, QString subtitle)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE AlbumTable SET subtitle = :subtitle WHERE "
-                  "id = :album_id");
-    query.bindValue(":subtitle", subtitle);
-    query.bindValue(":album_id", albumId);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    QVariantMap values;
+    values.insert(":subtitle", subtitle);
+    values.insert(":album_id", albumId);
+    m_db->getWriter()->enqueue(QString("AlbumTable.subtitle/%1").arg(albumId),
+                               "UPDATE AlbumTable SET subtitle = :subtitle WHERE "
+                               "id = :album_id", values);
 }
@@ -20,8 +20,10 @@
 #ifndef ALBUMTABLE_H
 #define ALBUMTABLE_H
 
+#include <QHash>
 #include <QList>
 #include <QObject>
+#include <QVector>
 
 class Album;
 class Database;
@@ -36,15 +38,13 @@ class AlbumTable : public QObject
 public:
     explicit AlbumTable(Database* db, QObject* parent = 0);
 
-    void getAlbums(QList<Album*>* albumSet);
+    void getAlbums(QList<Album*>* albumSet, QHash<qint64, QVector<qint64> >* albumMedia);
 
     void addAlbum(Album* album);
     void removeAlbum(Album* album);
 
-    void attachToAlbum(qint64 albumId, qint64 mediaId);
-    void detachFromAlbum(qint64 albumId, qint64 mediaId);
-
-    void mediaForAlbum(qint64 albumId, QList<qint64>* list) const;
+    void attachMany(qint64 albumId, const QList<qint64>& mediaIds);
+    void detachMany(qint64 albumId, const QList<qint64>& mediaIds);
 
     void setIsClosed(qint64 albumId, bool isClosed);
 
@@ -55,9 +55,9 @@ public:
     void setSubtitle(qint64 albumId, QString subtitle);
 
 private:
-    Database* m_db;
+    void executeForMany(const QString& sql, qint64 albumId, const QList<qint64>& mediaIds);
 
-    bool isAttachedToAlbum(qint64 albumId, qint64 mediaId) const;
+    Database* m_db;
 };
 
 #endif // ALBUMTABLE_H
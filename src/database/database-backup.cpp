@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database-backup.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <sqlite3.h>
+
+const int DatabaseBackup::STEP_PAGES = 64;
+const int DatabaseBackup::STEP_INTERVAL = 20;
+
+/*!
+ * \brief DatabaseBackup::DatabaseBackup
+ * \param backupName the file to store the backup in
+ * \param parent
+ */
+DatabaseBackup::DatabaseBackup(const QString& backupName, QObject *parent)
+    : QObject(parent),
+      m_backupName(backupName),
+      m_destination(0),
+      m_backup(0),
+      m_stepTimer(this)
+{
+    m_stepTimer.setInterval(STEP_INTERVAL);
+    QObject::connect(&m_stepTimer, SIGNAL(timeout()), this, SLOT(step()));
+}
+
+/*!
+ * \brief DatabaseBackup::~DatabaseBackup a backup that is still running gets
+ * dropped, the old backup stays
+ */
+DatabaseBackup::~DatabaseBackup()
+{
+    if (isRunning())
+        complete(false);
+}
+
+/*!
+ * \brief DatabaseBackup::start starts copying the database. A backup that is
+ * already running continues.
+ * \param source
+ */
+void DatabaseBackup::start(sqlite3 *source)
+{
+    if (isRunning() || !source)
+        return;
+
+    QFile::remove(temporaryName());
+    if (sqlite3_open(QFile::encodeName(temporaryName()).constData(), &m_destination) != SQLITE_OK) {
+        qDebug() << "Could not create backup: " << sqlite3_errmsg(m_destination);
+        complete(false);
+        return;
+    }
+
+    m_backup = sqlite3_backup_init(m_destination, "main", source, "main");
+    if (!m_backup) {
+        qDebug() << "Could not create backup: " << sqlite3_errmsg(m_destination);
+        complete(false);
+        return;
+    }
+
+    m_stepTimer.start();
+}
+
+/*!
+ * \brief DatabaseBackup::finish copies everything that is left right away
+ */
+void DatabaseBackup::finish()
+{
+    if (!isRunning())
+        return;
+
+    m_stepTimer.stop();
+    copyPages(-1);
+}
+
+/*!
+ * \brief DatabaseBackup::isRunning
+ * \return
+ */
+bool DatabaseBackup::isRunning() const
+{
+    return m_backup != 0;
+}
+
+/*!
+ * \brief DatabaseBackup::step
+ */
+void DatabaseBackup::step()
+{
+    copyPages(STEP_PAGES);
+}
+
+/*!
+ * \brief DatabaseBackup::copyPages
+ * \param pages number of pages to copy, -1 for all
+ */
+void DatabaseBackup::copyPages(int pages)
+{
+    int result = sqlite3_backup_step(m_backup, pages);
+    if (result == SQLITE_DONE) {
+        complete(true);
+        return;
+    }
+
+    if (result == SQLITE_OK || result == SQLITE_BUSY || result == SQLITE_LOCKED) {
+        // More to copy, or the database is in use right now. Go on with the
+        // next step.
+        if (pages >= 0)
+            return;
+    } else {
+        qDebug() << "Backup failed: " << sqlite3_errstr(result);
+    }
+
+    complete(false);
+}
+
+/*!
+ * \brief DatabaseBackup::complete releases the copy, and replaces the old
+ * backup by it, if everything went well
+ * \param success
+ */
+void DatabaseBackup::complete(bool success)
+{
+    m_stepTimer.stop();
+
+    if (m_backup) {
+        sqlite3_backup_finish(m_backup);
+        m_backup = 0;
+    }
+
+    if (success)
+        success = verify();
+
+    if (m_destination) {
+        sqlite3_close(m_destination);
+        m_destination = 0;
+    }
+
+    if (success) {
+        QFile::remove(m_backupName);
+        success = QFile::rename(temporaryName(), m_backupName);
+    } else {
+        QFile::remove(temporaryName());
+    }
+
+    emit finished(success);
+}
+
+/*!
+ * \brief DatabaseBackup::verify runs a quick integrity check on the copy
+ * \return
+ */
+bool DatabaseBackup::verify() const
+{
+    sqlite3_stmt *statement = 0;
+    if (sqlite3_prepare_v2(m_destination, "PRAGMA quick_check", -1, &statement, 0) != SQLITE_OK)
+        return false;
+
+    bool ok = false;
+    if (sqlite3_step(statement) == SQLITE_ROW) {
+        const char *result = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+        ok = result && qstrcmp(result, "ok") == 0;
+    }
+    sqlite3_finalize(statement);
+
+    if (!ok)
+        qDebug() << "Backup is corrupt, keeping the old one";
+
+    return ok;
+}
+
+/*!
+ * \brief DatabaseBackup::temporaryName
+ * \return the file, the backup is written to before it is verified
+ */
+QString DatabaseBackup::temporaryName() const
+{
+    return m_backupName + ".tmp";
+}
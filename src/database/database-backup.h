@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+struct sqlite3;
+struct sqlite3_backup;
+
+/*!
+ * \brief The DatabaseBackup class copies a database with the SQLite online
+ * backup API. The copy is done in small steps, so the database stays usable
+ * meanwhile. The finished copy is checked, and replaces the old backup only
+ * if it is fine.
+ */
+class DatabaseBackup : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DatabaseBackup(const QString& backupName, QObject *parent = 0);
+    virtual ~DatabaseBackup();
+
+    void start(sqlite3 *source);
+    void finish();
+    bool isRunning() const;
+
+signals:
+    void finished(bool success);
+
+private slots:
+    void step();
+
+private:
+    // Pages copied per step
+    static const int STEP_PAGES;
+    // Pause between two steps in ms
+    static const int STEP_INTERVAL;
+
+    void copyPages(int pages);
+    void complete(bool success);
+    bool verify() const;
+    QString temporaryName() const;
+
+    QString m_backupName;
+    sqlite3 *m_destination;
+    sqlite3_backup *m_backup;
+    QTimer m_stepTimer;
+};
+
+#endif // DATABASEBACKUP_H
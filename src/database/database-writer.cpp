@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database-writer.h"
+#include "database.h"
+
+#include <QMutexLocker>
+#include <QtSql>
+
+const int DatabaseWriterWorker::WRITE_DELAY = 250;
+
+/*!
+ * \brief DatabaseWriter::DatabaseWriter
+ * \param db
+ * \param parent
+ */
+DatabaseWriter::DatabaseWriter(Database *db, QObject *parent)
+    : QObject(parent),
+      m_workerThread(this)
+{
+    m_worker = new DatabaseWriterWorker(db);
+    m_worker->moveToThread(&m_workerThread);
+    QObject::connect(&m_workerThread, SIGNAL(finished()),
+                     m_worker, SLOT(deleteLater()));
+
+    m_workerThread.start(QThread::LowPriority);
+}
+
+/*!
+ * \brief DatabaseWriter::~DatabaseWriter writes all pending updates
+ */
+DatabaseWriter::~DatabaseWriter()
+{
+    flush();
+
+    m_workerThread.quit();
+    m_workerThread.wait();
+}
+
+/*!
+ * \brief DatabaseWriter::enqueue adds an update, that is written soon
+ * \param key identifies the row and columns that get changed. A pending update
+ * with the same key is replaced
+ * \param sql
+ * \param values the values to bind to the query
+ */
+void DatabaseWriter::enqueue(const QString& key, const QString& sql, const QVariantMap& values)
+{
+    m_worker->enqueue(key, sql, values);
+}
+
+/*!
+ * \brief DatabaseWriter::flush writes all pending updates, and returns once
+ * they are in the database
+ */
+void DatabaseWriter::flush()
+{
+    m_worker->writePending();
+}
+
+/*!
+ * \brief DatabaseWriterWorker::DatabaseWriterWorker
+ * \param db
+ * \param parent
+ */
+DatabaseWriterWorker::DatabaseWriterWorker(Database *db, QObject *parent)
+    : QObject(parent),
+      m_db(db),
+      m_writeTimer(this),
+      m_writing(false)
+{
+    m_writeTimer.setInterval(WRITE_DELAY);
+    m_writeTimer.setSingleShot(true);
+    QObject::connect(&m_writeTimer, SIGNAL(timeout()), this, SLOT(onWriteTimeout()));
+}
+
+/*!
+ * \brief DatabaseWriterWorker::enqueue can be called from any thread
+ * \param key
+ * \param sql
+ * \param values
+ */
+void DatabaseWriterWorker::enqueue(const QString& key, const QString& sql, const QVariantMap& values)
+{
+    QMutexLocker locker(&m_mutex);
+
+    bool wasEmpty = m_order.isEmpty();
+    if (!m_pending.contains(key))
+        m_order.append(key);
+
+    PendingWrite &write = m_pending[key];
+    write.sql = sql;
+    write.values = values;
+
+    if (wasEmpty)
+        QMetaObject::invokeMethod(&m_writeTimer, "start", Qt::QueuedConnection);
+}
+
+/*!
+ * \brief DatabaseWriterWorker::onWriteTimeout writes the updates collected meanwhile
+ */
+void DatabaseWriterWorker::onWriteTimeout()
+{
+    writePending();
+}
+
+/*!
+ * \brief DatabaseWriterWorker::writePending writes all pending updates in one
+ * transaction, using the connection of the calling thread.
+ * Waits for a write that is already in progress first, so all updates
+ * enqueued before are in the database when this returns.
+ */
+void DatabaseWriterWorker::writePending()
+{
+    QList<PendingWrite> writes;
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_writing)
+            m_writeFinished.wait(&m_mutex);
+
+        if (m_order.isEmpty())
+            return;
+
+        foreach (const QString &key, m_order)
+            writes.append(m_pending.take(key));
+        m_order.clear();
+        m_writing = true;
+    }
+
+    {
+        QMutexLocker writeLocker(m_db->writeLock());
+        QSqlDatabase *db = m_db->getDB();
+        db->transaction();
+
+        foreach (const PendingWrite &write, writes) {
+            QSqlQuery query = m_db->prepare(write.sql);
+            QVariantMap::const_iterator it;
+            for (it = write.values.constBegin(); it != write.values.constEnd(); ++it)
+                query.bindValue(it.key(), it.value());
+            if (!m_db->exec(query))
+                m_db->logSqlError(query);
+        }
+
+        if (!db->commit())
+            qDebug() << "SQLite error: " << db->lastError();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_writing = false;
+    m_writeFinished.wakeAll();
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASEWRITER_H
+#define DATABASEWRITER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QVariantMap>
+#include <QWaitCondition>
+
+class Database;
+class DatabaseWriterWorker;
+
+/*!
+ * \brief The DatabaseWriter class executes updates of the database in the
+ * background, so the calling thread does not wait for the disk.
+ * Updates with the same key replace each other, so only the last one is
+ * written.
+ */
+class DatabaseWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DatabaseWriter(Database *db, QObject *parent = 0);
+    virtual ~DatabaseWriter();
+
+    void enqueue(const QString& key, const QString& sql, const QVariantMap& values);
+    void flush();
+
+private:
+    DatabaseWriterWorker *m_worker;
+    QThread m_workerThread;
+};
+
+/*!
+ * \brief The DatabaseWriterWorker class does the work for the DatabaseWriter
+ */
+class DatabaseWriterWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DatabaseWriterWorker(Database *db, QObject *parent = 0);
+
+    void enqueue(const QString& key, const QString& sql, const QVariantMap& values);
+    void writePending();
+
+public slots:
+    void onWriteTimeout();
+
+private:
+    // Time to wait for more updates, before writing them
+    static const int WRITE_DELAY;
+
+    struct PendingWrite {
+        QString sql;
+        QVariantMap values;
+    };
+
+    Database *m_db;
+    QTimer m_writeTimer;
+    QMutex m_mutex;
+    QWaitCondition m_writeFinished;
+    QStringList m_order;
+    QHash<QString, PendingWrite> m_pending;
+    bool m_writing;
+};
+
+#endif // DATABASEWRITER_H
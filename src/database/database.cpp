@@ -20,13 +20,45 @@
 
 #include "database.h"
 #include "album-table.h"
+#include "database-backup.h"
+#include "database-writer.h"
+#include "library-snapshot.h"
 #include "media-table.h"
 #include "resource.h"
 
+#include <QElapsedTimer>
 #include <QFile>
 #include <QSqlTableModel>
+#include <QThread>
 #include <QtSql>
 
+#include <sqlite3.h>
+
+// Time without any write, before the write ahead log gets checkpointed
+const int CHECKPOINT_IDLE_TIME = 3000;
+// Number of writes, after which the write ahead log is truncated
+const int LARGE_IMPORT_WRITES = 1000;
+
+/*!
+ * \brief The QueryExecution struct collects the time and the rows of one
+ * execution of a statement, until all its rows are read
+ */
+struct QueryExecution {
+    QueryExecution() : time(0), rows(0) {}
+    qint64 time;
+    qint64 rows;
+};
+
+/*!
+ * \brief The Database::Connection struct is the connection of one thread,
+ * with the statements prepared for it
+ */
+struct Database::Connection {
+    QSqlDatabase db;
+    QHash<QString, QSqlQuery> statements;
+    QHash<QString, QueryExecution> executions;
+};
+
 /*!
  * \brief Database::Database
  * \param databaseDir directory to load/store the database
@@ -37,8 +69,25 @@ Database::Database(Resource *resource, QObject* parent) :
     QObject(parent),
     m_databaseDirectory(resource->databaseDirectory()),
     m_sqlSchemaDirectory(resource->getRcUrl("sql").path()),
-    m_db(new QSqlDatabase())
+    m_db(new QSqlDatabase()),
+    m_statementCacheHits(0),
+    m_statementCacheMisses(0),
+    m_logQueries(false),
+    m_slowQueryTime(0),
+    m_connectionCount(0),
+    m_writesSinceCheckpoint(0),
+    m_writesAtLastCheck(0),
+    m_idleTimer(this),
+    m_writeGeneration(0),
+    m_backupGeneration(0),
+    m_backup(new DatabaseBackup(getDBBackupName(), this)),
+    m_snapshot(0)
 {
+    m_idleTimer.setInterval(CHECKPOINT_IDLE_TIME);
+    m_idleTimer.setSingleShot(true);
+    QObject::connect(&m_idleTimer, SIGNAL(timeout()), this, SLOT(onIdleTimeout()));
+    QObject::connect(m_backup, SIGNAL(finished(bool)), this, SLOT(onBackupFinished(bool)));
+
     if (!QFile::exists(m_databaseDirectory)) {
         QDir dir;
         bool createOk = dir.mkpath(m_databaseDirectory);
@@ -48,6 +97,7 @@ Database::Database(Resource *resource, QObject* parent) :
 
     m_albumTable = new AlbumTable(this, this);
     m_mediaTable = new MediaTable(this, resource, this);
+    m_writer = new DatabaseWriter(this, this);
 
     // Open the database.
     if (!openDB())
@@ -60,21 +110,18 @@ Database::Database(Resource *resource, QObject* parent) :
         restoreFromBackup();
     }
 
+    // Use a write ahead log, so the connections of other threads can read
+    // while one of them writes.
     QSqlQuery query(*m_db);
-    // Turn synchronous off.
-    if (!query.exec("PRAGMA synchronous = OFF")) {
+    if (!query.exec("PRAGMA journal_mode = WAL"))
         logSqlError(query);
-        return;
-    }
 
-    // Enable foreign keys.
-    if (!query.exec("PRAGMA foreign_keys = ON")) {
-        logSqlError(query);
-        return;
+    if (configureConnection(*m_db)) {
+        // Update if needed.
+        upgradeSchema(schemaVersion());
     }
 
-    // Update if needed.
-    upgradeSchema(schemaVersion());
+    m_snapshot = new LibrarySnapshot(this, getSnapshotName(), schemaVersion(), this);
 }
 
 /*!
@@ -82,11 +129,25 @@ Database::Database(Resource *resource, QObject* parent) :
  */
 Database::~Database()
 {
+    // Writes a snapshot of the latest changes
+    delete m_snapshot;
+
+    // Waits for the pending updates to be written
+    delete m_writer;
     delete m_albumTable;
     delete m_mediaTable;
-    delete m_db;
 
+    // Move everything into the database file, and complete the backup
+    checkpoint(true);
     createBackup();
+    m_backup->finish();
+    delete m_backup;
+
+    closeConnections();
+    delete m_db;
+
+    if (m_logQueries)
+        logQueryStatistics();
 }
 
 /*!
@@ -99,6 +160,375 @@ void Database::logSqlError(QSqlQuery& q) const
     qDebug() << "SQLite string: " << q.lastQuery();
 }
 
+/*!
+ * \brief Database::configureConnection sets the options, that SQLite keeps
+ * per connection
+ * \param db
+ * \return
+ */
+bool Database::configureConnection(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    // With the write ahead log, syncing on checkpoints only is safe
+    if (!query.exec("PRAGMA synchronous = NORMAL")) {
+        logSqlError(query);
+        return false;
+    }
+
+    // Enable foreign keys.
+    if (!query.exec("PRAGMA foreign_keys = ON")) {
+        logSqlError(query);
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Database::connection returns the connection of the calling thread.
+ * A Qt SQL connection must only be used by the thread that created it, so
+ * every thread gets its own one to the same database file. The thread owning
+ * the database uses the main connection.
+ * \return
+ */
+Database::Connection* Database::connection()
+{
+    QThread *current = QThread::currentThread();
+
+    QMutexLocker locker(&m_connectionsMutex);
+    Connection *c = m_connections.value(current);
+    if (c)
+        return c;
+
+    c = new Connection;
+    if (current == thread()) {
+        c->db = *m_db;
+    } else {
+        QString name = QString("gallery-thread-%1").arg(++m_connectionCount);
+        c->db = QSqlDatabase::addDatabase("QSQLITE", name);
+        c->db.setDatabaseName(getDBname());
+        if (!c->db.open())
+            qDebug() << "Error opening DB: " << c->db.lastError().text();
+        else
+            configureConnection(c->db);
+
+        // The connection must be closed by the thread itself
+        connect(current, SIGNAL(finished()), this, SLOT(closeThreadConnection()),
+                Qt::DirectConnection);
+    }
+
+    m_connections.insert(current, c);
+    return c;
+}
+
+/*!
+ * \brief Database::closeThreadConnection closes the connection of the thread
+ * that is about to finish
+ */
+void Database::closeThreadConnection()
+{
+    QMutexLocker locker(&m_connectionsMutex);
+    Connection *c = m_connections.take(QThread::currentThread());
+    if (!c)
+        return;
+
+    QString name = c->db.connectionName();
+    finishExecutions(c);
+    c->statements.clear();
+    c->db.close();
+    delete c;
+
+    QSqlDatabase::removeDatabase(name);
+}
+
+/*!
+ * \brief Database::closeConnections releases all prepared statements and
+ * closes the connections of the other threads
+ */
+void Database::closeConnections()
+{
+    QMutexLocker locker(&m_connectionsMutex);
+    QStringList names;
+    foreach (Connection *c, m_connections) {
+        finishExecutions(c);
+        c->statements.clear();
+        if (c->db.connectionName() != m_db->connectionName()) {
+            names.append(c->db.connectionName());
+            c->db.close();
+        }
+        delete c;
+    }
+    m_connections.clear();
+
+    foreach (const QString &name, names)
+        QSqlDatabase::removeDatabase(name);
+}
+
+/*!
+ * \brief Database::writeLock all changes to the database have to be done
+ * while holding this lock, so only one connection writes at a time
+ * \return
+ */
+QMutex* Database::writeLock()
+{
+    m_writeGeneration.ref();
+
+    // The first write after a checkpoint schedules the next one
+    if (m_writesSinceCheckpoint.fetchAndAddOrdered(1) == 0)
+        QMetaObject::invokeMethod(this, "scheduleCheckpoint", Qt::QueuedConnection);
+
+    return &m_writeMutex;
+}
+
+/*!
+ * \brief Database::scheduleCheckpoint checkpoints the write ahead log, as soon
+ * as there were no writes for a while
+ */
+void Database::scheduleCheckpoint()
+{
+    m_writesAtLastCheck = m_writesSinceCheckpoint.load();
+    m_idleTimer.start();
+}
+
+/*!
+ * \brief Database::onIdleTimeout
+ */
+void Database::onIdleTimeout()
+{
+    int writes = m_writesSinceCheckpoint.load();
+    if (writes != m_writesAtLastCheck) {
+        // Still busy writing
+        m_writesAtLastCheck = writes;
+        m_idleTimer.start();
+        return;
+    }
+
+    writes = m_writesSinceCheckpoint.fetchAndStoreOrdered(0);
+    checkpoint(writes >= LARGE_IMPORT_WRITES);
+
+    createBackup();
+}
+
+/*!
+ * \brief Database::onBackupFinished
+ * \param success if false, the backup is tried again next time
+ */
+void Database::onBackupFinished(bool success)
+{
+    if (!success)
+        m_backupGeneration = -1;
+}
+
+/*!
+ * \brief Database::checkpoint copies the changes from the write ahead log into
+ * the database
+ * \param truncate if false, the checkpoint does not wait for other
+ * connections and the log keeps its size. If true, the log is emptied, which
+ * is done after big changes, so it does not stay big
+ */
+void Database::checkpoint(bool truncate)
+{
+    QSqlQuery query(*m_db);
+    if (truncate) {
+        QMutexLocker locker(&m_writeMutex);
+        if (!query.exec("PRAGMA wal_checkpoint(TRUNCATE)"))
+            logSqlError(query);
+    } else {
+        if (!query.exec("PRAGMA wal_checkpoint(PASSIVE)"))
+            logSqlError(query);
+    }
+}
+
+/*!
+ * \brief Database::prepare returns a prepared statement for the given SQL.
+ * Statements are compiled only once and reused afterwards, so all values have
+ * to be bound again before executing the query.
+ * A statement must not be requested again while its results are still being
+ * read, and queries not read until the end should be finished, so they don't
+ * keep the read transaction open.
+ * \param sql
+ * \return
+ */
+QSqlQuery Database::prepare(const QString& sql)
+{
+    Connection *c = connection();
+
+    QHash<QString, QSqlQuery>::iterator it = c->statements.find(sql);
+    if (it != c->statements.end()) {
+        m_statementCacheHits.ref();
+        it->finish();
+        if (m_logQueries)
+            finishExecution(c, sql);
+        return *it;
+    }
+
+    m_statementCacheMisses.ref();
+    QSqlQuery query(c->db);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql)) {
+        logSqlError(query);
+        return query;
+    }
+
+    c->statements.insert(sql, query);
+    return query;
+}
+
+/*!
+ * \brief Database::statementCacheHits
+ * \return the number of statements that could be reused
+ */
+int Database::statementCacheHits() const
+{
+    return m_statementCacheHits.load();
+}
+
+/*!
+ * \brief Database::statementCacheMisses
+ * \return the number of statements that needed to be compiled
+ */
+int Database::statementCacheMisses() const
+{
+    return m_statementCacheMisses.load();
+}
+
+/*!
+ * \brief Database::exec executes the query. If query logging is enabled, the
+ * time it takes is added to the statistics of the statement
+ * \param query
+ * \return
+ */
+bool Database::exec(QSqlQuery& query)
+{
+    if (!m_logQueries)
+        return query.exec();
+
+    Connection *c = connection();
+    QString sql = query.lastQuery();
+    finishExecution(c, sql);
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.exec();
+    QueryExecution &execution = c->executions[sql];
+    execution.time += timer.nsecsElapsed();
+
+    // Changes are done by now, results are counted while they are read
+    if (!query.isSelect()) {
+        execution.rows += qMax(query.numRowsAffected(), 0);
+        finishExecution(c, sql);
+    }
+
+    return ok;
+}
+
+/*!
+ * \brief Database::next moves to the next row of the query. If query logging
+ * is enabled, the time and the row are added to the current execution of the
+ * statement
+ * \param query
+ * \return
+ */
+bool Database::next(QSqlQuery& query)
+{
+    if (!m_logQueries)
+        return query.next();
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.next();
+    qint64 time = timer.nsecsElapsed();
+
+    Connection *c = connection();
+    QString sql = query.lastQuery();
+    QueryExecution &execution = c->executions[sql];
+    execution.time += time;
+    if (ok)
+        execution.rows++;
+    else
+        finishExecution(c, sql);
+
+    return ok;
+}
+
+/*!
+ * \brief Database::setQueryLogging enables collecting statistics for all
+ * statements, which are printed when the database is closed
+ * \param slowQueryTime queries taking longer than that (in milliseconds) are
+ * logged right away
+ */
+void Database::setQueryLogging(int slowQueryTime)
+{
+    m_slowQueryTime = slowQueryTime * Q_INT64_C(1000000);
+    m_logQueries = true;
+}
+
+/*!
+ * \brief Database::finishExecution adds the current execution of a statement
+ * to its statistics
+ * \param c
+ * \param sql
+ */
+void Database::finishExecution(Connection *c, const QString& sql)
+{
+    QHash<QString, QueryExecution>::iterator it = c->executions.find(sql);
+    if (it == c->executions.end())
+        return;
+
+    QueryExecution execution = *it;
+    c->executions.erase(it);
+
+    if (execution.time >= m_slowQueryTime) {
+        qDebug() << "Slow SQL query:" << execution.time / 1000000 << "ms"
+                 << execution.rows << "rows" << sql.simplified();
+    }
+
+    QMutexLocker locker(&m_statisticsMutex);
+    Statistics &statistics = m_statistics[sql];
+    statistics.executions++;
+    statistics.rows += execution.rows;
+    statistics.totalTime += execution.time;
+    statistics.maxTime = qMax(statistics.maxTime, execution.time);
+}
+
+/*!
+ * \brief Database::finishExecutions finishes all executions of the connection
+ * \param c
+ */
+void Database::finishExecutions(Connection *c)
+{
+    foreach (const QString &sql, c->executions.keys())
+        finishExecution(c, sql);
+}
+
+/*!
+ * \brief Database::logQueryStatistics prints the statistics of all statements,
+ * the ones that took the most time in total first
+ */
+void Database::logQueryStatistics()
+{
+    QMutexLocker locker(&m_statisticsMutex);
+
+    QMultiMap<qint64, QString> byTime;
+    QHash<QString, Statistics>::const_iterator it;
+    for (it = m_statistics.constBegin(); it != m_statistics.constEnd(); ++it)
+        byTime.insert(it.value().totalTime, it.key());
+
+    qDebug() << "SQL statistics (executions, total ms, max ms, rows, statement):";
+    QMapIterator<qint64, QString> i(byTime);
+    i.toBack();
+    while (i.hasPrevious()) {
+        i.previous();
+        const Statistics &statistics = m_statistics[i.value()];
+        qDebug() << statistics.executions << statistics.totalTime / 1000000
+                 << statistics.maxTime / 1000000 << statistics.rows
+                 << i.value().simplified();
+    }
+
+    qDebug() << "Statement cache hits:" << m_statementCacheHits.load()
+             << "misses:" << m_statementCacheMisses.load();
+}
+
 /*!
  * \brief Database::openDB Open the SQLite database
  * \return
@@ -223,13 +653,31 @@ MediaTable* Database::getMediaTable() const
     return m_mediaTable;
 }
 
+/*!
+ * \brief Database::getWriter
+ * \return the writer for updates, that are done in the background
+ */
+DatabaseWriter* Database::getWriter() const
+{
+    return m_writer;
+}
+
+/*!
+ * \brief Database::getSnapshot
+ * \return the snapshot of the media, used to load them at startup
+ */
+LibrarySnapshot* Database::getSnapshot() const
+{
+    return m_snapshot;
+}
+
 /*!
  * \brief Database::getDB
- * \return
+ * \return the connection of the calling thread
  */
 QSqlDatabase* Database::getDB()
 {
-    return m_db;
+    return &connection()->db;
 }
 
 /*!
@@ -259,11 +707,21 @@ QString Database::getDBBackupName() const
     return getDBname() + ".bak";
 }
 
+/*!
+* \brief Database::getSnapshotName
+* \return the filename for the snapshot of the media
+*/
+QString Database::getSnapshotName() const
+{
+    return m_databaseDirectory + "/gallery.snapshot";
+}
+
 /*!
  * \brief Database::restore_from_backup Restores the database from the auto-backup, if possible
  */
 void Database::restoreFromBackup()
 {
+    closeConnections();
     m_db->close();
 
     // Remove existing DB.
@@ -271,6 +729,12 @@ void Database::restoreFromBackup()
     if (!bad_db.remove())
         qDebug() << "Could not remove old file.";
 
+    // The log of the broken DB must not be applied to the backup
+    QFile::remove(getDBname() + "-wal");
+    QFile::remove(getDBname() + "-shm");
+    // The snapshot was taken from the broken DB as well
+    QFile::remove(getSnapshotName());
+
     // Copy the backup, if it exists.
     QFile file(getDBBackupName());
     if (file.exists()) {
@@ -282,15 +746,28 @@ void Database::restoreFromBackup()
 }
 
 /*!
- * \brief Database::create_backup Creates the auto-backup
+ * \brief Database::create_backup Starts updating the auto-backup, if anything
+ * was written since the last one. The backup is done in the background.
  */
 void Database::createBackup()
 {
-    QFile old_backup(getDBBackupName());
-    if (!old_backup.remove())
-        qDebug() << "Could not remove existing backup.";
+    int generation = m_writeGeneration.load();
+    if (generation == m_backupGeneration && QFile::exists(getDBBackupName()))
+        return;
+
+    m_backupGeneration = generation;
+    m_backup->start(sqliteHandle());
+}
+
+/*!
+ * \brief Database::sqliteHandle
+ * \return the SQLite handle of the main connection
+ */
+sqlite3* Database::sqliteHandle() const
+{
+    QVariant handle = m_db->driver()->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0)
+        return 0;
 
-    // Copy the database to the backup.
-    QFile file(getDBname());
-    file.copy(getDBBackupName());
+    return *static_cast<sqlite3**>(handle.data());
 }
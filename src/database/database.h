@@ -20,17 +20,27 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <QAtomicInt>
 #include <QFile>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QString>
+#include <QTimer>
 
 class AlbumTable;
+class DatabaseBackup;
+class DatabaseWriter;
+class LibrarySnapshot;
 class MediaTable;
 
 class QSqlDatabase;
 class QSqlQuery;
+class QThread;
 class Resource;
 
+struct sqlite3;
+
 const qint64 INVALID_ID = -1;
 
 /*!
@@ -48,11 +58,49 @@ public:
     void logSqlError(QSqlQuery& q) const;
     QSqlDatabase* getDB();
 
+    QSqlQuery prepare(const QString& sql);
+    int statementCacheHits() const;
+    int statementCacheMisses() const;
+
+    bool exec(QSqlQuery& query);
+    bool next(QSqlQuery& query);
+    void setQueryLogging(int slowQueryTime);
+
+    QMutex* writeLock();
+
     AlbumTable* getAlbumTable() const;
     MediaTable* getMediaTable() const;
+    DatabaseWriter* getWriter() const;
+    LibrarySnapshot* getSnapshot() const;
+
+private slots:
+    void closeThreadConnection();
+    void scheduleCheckpoint();
+    void onIdleTimeout();
+    void onBackupFinished(bool success);
 
 private:
+    struct Connection;
+
+    /*!
+     * \brief The Statistics struct sums up all executions of one statement
+     */
+    struct Statistics {
+        Statistics() : executions(0), rows(0), totalTime(0), maxTime(0) {}
+        int executions;
+        qint64 rows;
+        qint64 totalTime;
+        qint64 maxTime;
+    };
+
     bool openDB();
+    bool configureConnection(QSqlDatabase& db);
+    Connection* connection();
+    void closeConnections();
+
+    void finishExecution(Connection *c, const QString& sql);
+    void finishExecutions(Connection *c);
+    void logQueryStatistics();
 
     int schemaVersion() const;
     void setSchemaVersion(int version);
@@ -64,16 +112,38 @@ private:
 
     QString getDBname() const;
     QString getDBBackupName() const;
+    QString getSnapshotName() const;
 
     void restoreFromBackup();
 
     void createBackup();
+    sqlite3* sqliteHandle() const;
+
+    void checkpoint(bool truncate);
 
     QString m_databaseDirectory;
     QString m_sqlSchemaDirectory;
     QSqlDatabase* m_db;
+    QHash<QThread*, Connection*> m_connections;
+    QMutex m_connectionsMutex;
+    QMutex m_writeMutex;
+    QAtomicInt m_statementCacheHits;
+    QAtomicInt m_statementCacheMisses;
+    bool m_logQueries;
+    qint64 m_slowQueryTime;
+    QHash<QString, Statistics> m_statistics;
+    QMutex m_statisticsMutex;
+    int m_connectionCount;
+    QAtomicInt m_writesSinceCheckpoint;
+    int m_writesAtLastCheck;
+    QTimer m_idleTimer;
+    QAtomicInt m_writeGeneration;
+    int m_backupGeneration;
+    DatabaseBackup* m_backup;
     AlbumTable* m_albumTable;
     MediaTable* m_mediaTable;
+    DatabaseWriter* m_writer;
+    LibrarySnapshot* m_snapshot;
 };
 
 #endif // DATABASE_H
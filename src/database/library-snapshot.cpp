@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "library-snapshot.h"
+#include "database.h"
+#include "database-writer.h"
+
+#include <QMutexLocker>
+#include <QVector>
+#include <QtSql>
+
+#include <string.h>
+
+const int LibrarySnapshotWorker::WRITE_DELAY = 5000;
+
+// Identifies the file, and the layout of the header and the records
+static const char SNAPSHOT_MAGIC[8] = { 'G', 'A', 'L', 'S', 'N', 'A', 'P', '\0' };
+static const quint32 SNAPSHOT_FORMAT = 3;
+
+/*!
+ * \brief The LibrarySnapshot::Header struct is at the start of the file
+ */
+struct LibrarySnapshot::Header {
+    char magic[8];
+    quint32 format;
+    qint32 schemaVersion;
+    quint32 count;
+    quint32 poolSize;
+};
+
+/*!
+ * \brief The LibrarySnapshot::Record struct is one row of the MediaTable.
+ * The directory and the basename are offsets into the string pool, that
+ * follows the records. Each directory is stored only once.
+ */
+struct LibrarySnapshot::Record {
+    qint64 id;
+    qint64 timestamp;
+    qint64 exposureTime;
+    qint64 filesize;
+    qint32 width;
+    qint32 height;
+    quint32 directory;
+    quint32 basename;
+    qint32 orientation;
+    qint32 mediaType;
+    // ARGB, 0 if there is none
+    quint32 placeholderColor;
+    // Keeps the size a multiple of 8, the same on all platforms
+    quint32 padding;
+};
+
+/*!
+ * \brief appendString adds a string to the pool, as its length followed by
+ * the UTF-16 characters, padded to 4 bytes
+ * \param pool
+ * \param string
+ * \return the offset of the string in the pool
+ */
+static quint32 appendString(QByteArray *pool, const QString& string)
+{
+    quint32 offset = pool->size();
+    quint32 length = string.length();
+    pool->append(reinterpret_cast<const char*>(&length), sizeof(length));
+    pool->append(reinterpret_cast<const char*>(string.constData()), length * sizeof(QChar));
+    while (pool->size() % 4)
+        pool->append('\0');
+
+    return offset;
+}
+
+/*!
+ * \brief LibrarySnapshot::LibrarySnapshot
+ * \param db
+ * \param fileName the file to store the snapshot in
+ * \param schemaVersion a snapshot of another schema version is not used
+ * \param parent
+ */
+LibrarySnapshot::LibrarySnapshot(Database *db, const QString& fileName,
+                                 int schemaVersion, QObject *parent)
+    : QObject(parent),
+      m_db(db),
+      m_fileName(fileName),
+      m_schemaVersion(schemaVersion),
+      m_data(0),
+      m_records(0),
+      m_pool(0),
+      m_count(0),
+      m_poolSize(0),
+      m_changes(0),
+      m_changesInProgress(0),
+      m_writePending(false),
+      m_exists(QFile::exists(fileName)),
+      m_workerThread(this)
+{
+    m_worker = new LibrarySnapshotWorker(this);
+    m_worker->moveToThread(&m_workerThread);
+    QObject::connect(&m_workerThread, SIGNAL(finished()),
+                     m_worker, SLOT(deleteLater()));
+
+    m_workerThread.start(QThread::LowPriority);
+}
+
+/*!
+ * \brief LibrarySnapshot::~LibrarySnapshot writes a snapshot that is still
+ * pending, so the next start does not need to read the database
+ */
+LibrarySnapshot::~LibrarySnapshot()
+{
+    m_workerThread.quit();
+    m_workerThread.wait();
+
+    close();
+
+    if (m_writePending)
+        write();
+}
+
+/*!
+ * \brief LibrarySnapshot::open maps the snapshot into memory
+ * \return false if there is no snapshot matching the database
+ */
+bool LibrarySnapshot::open()
+{
+    close();
+
+    m_file.setFileName(m_fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 fileSize = m_file.size();
+    if (fileSize >= (qint64)sizeof(Header))
+        m_data = m_file.map(0, fileSize);
+
+    const Header *header = reinterpret_cast<const Header*>(m_data);
+    qint64 expectedSize = -1;
+    if (header) {
+        expectedSize = qint64(sizeof(Header)) + qint64(header->count) * qint64(sizeof(Record)) +
+                qint64(header->poolSize);
+    }
+
+    if (expectedSize != fileSize || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+            header->format != SNAPSHOT_FORMAT || header->schemaVersion != m_schemaVersion) {
+        qDebug() << "Ignoring outdated library snapshot" << m_fileName;
+        close();
+        return false;
+    }
+
+    m_count = header->count;
+    m_poolSize = header->poolSize;
+    m_records = reinterpret_cast<const Record*>(m_data + sizeof(Header));
+    m_pool = m_data + sizeof(Header) + m_count * sizeof(Record);
+
+    return true;
+}
+
+/*!
+ * \brief LibrarySnapshot::count
+ * \return the number of media in the opened snapshot
+ */
+int LibrarySnapshot::count() const
+{
+    return m_count;
+}
+
+/*!
+ * \brief LibrarySnapshot::read gets one media of the opened snapshot, with
+ * the same values as MediaTable::row()
+ * \param index
+ */
+void LibrarySnapshot::read(int index, qint64 *mediaId, QString *filename, QSize *size,
+                           QDateTime *timestamp, QDateTime *exposureTime,
+                           Orientation *originalOrientation, qint64 *filesize,
+                           QColor *placeholderColor, MediaSource::MediaType *mediaType)
+{
+    Q_ASSERT(index >= 0 && index < m_count);
+    const Record &record = m_records[index];
+
+    QString &directory = m_directories[record.directory];
+    if (directory.isNull())
+        directory = string(record.directory);
+
+    *mediaId = record.id;
+    *filename = directory + string(record.basename);
+    *size = QSize(record.width, record.height);
+    timestamp->setMSecsSinceEpoch(record.timestamp);
+    exposureTime->setMSecsSinceEpoch(record.exposureTime);
+    *originalOrientation = static_cast<Orientation>(record.orientation);
+    *filesize = record.filesize;
+    *placeholderColor = record.placeholderColor ? QColor::fromRgba(record.placeholderColor) : QColor();
+    *mediaType = static_cast<MediaSource::MediaType>(record.mediaType);
+}
+
+/*!
+ * \brief LibrarySnapshot::close unmaps the snapshot
+ */
+void LibrarySnapshot::close()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+    m_file.close();
+
+    m_data = 0;
+    m_records = 0;
+    m_pool = 0;
+    m_count = 0;
+    m_poolSize = 0;
+    m_directories.clear();
+}
+
+/*!
+ * \brief LibrarySnapshot::string
+ * \param offset
+ * \return the string at the offset of the pool
+ */
+QString LibrarySnapshot::string(quint32 offset) const
+{
+    quint32 length;
+    if ((quint64)offset + sizeof(length) > m_poolSize)
+        return QString();
+
+    memcpy(&length, m_pool + offset, sizeof(length));
+    if ((quint64)offset + sizeof(length) + (quint64)length * sizeof(QChar) > m_poolSize)
+        return QString();
+
+    return QString(reinterpret_cast<const QChar*>(m_pool + offset + sizeof(length)), length);
+}
+
+/*!
+ * \brief LibrarySnapshot::beginChange has to be called before the media in
+ * the database get changed. Removes the snapshot, so it can't be used
+ * anymore, even if the application ends before a new one got written.
+ */
+void LibrarySnapshot::beginChange()
+{
+    QMutexLocker locker(&m_mutex);
+    m_changes++;
+    m_changesInProgress++;
+    removeFile();
+}
+
+/*!
+ * \brief LibrarySnapshot::endChange has to be called once the change is
+ * committed to the database
+ */
+void LibrarySnapshot::endChange()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_changes++;
+        m_changesInProgress--;
+    }
+
+    scheduleWrite();
+}
+
+/*!
+ * \brief LibrarySnapshot::invalidate is used for changes that are written
+ * later by the DatabaseWriter
+ */
+void LibrarySnapshot::invalidate()
+{
+    beginChange();
+    endChange();
+}
+
+/*!
+ * \brief LibrarySnapshot::scheduleWrite writes a new snapshot, once there
+ * were no changes for a while
+ */
+void LibrarySnapshot::scheduleWrite()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_writePending = true;
+    }
+
+    QMetaObject::invokeMethod(m_worker, "scheduleWrite", Qt::QueuedConnection);
+}
+
+/*!
+ * \brief LibrarySnapshot::write writes all media of the database into a new
+ * snapshot, using the connection of the calling thread.
+ * The snapshot is dropped, if the media changed while it was written. The
+ * change schedules the next one.
+ */
+void LibrarySnapshot::write()
+{
+    int changes;
+    {
+        QMutexLocker locker(&m_mutex);
+        changes = m_changes;
+        m_writePending = false;
+    }
+
+    // Updates queued before have to be part of the snapshot
+    m_db->getWriter()->flush();
+
+    QSqlQuery query = m_db->prepare("SELECT m.id, m.dir_id, d.path, m.basename, m.width, "
+                                    "m.height, m.timestamp, m.exposure_time, "
+                                    "m.original_orientation, m.filesize, m.media_type, "
+                                    "m.placeholder_color FROM MediaTable m "
+                                    "JOIN DirectoryTable d ON d.id = m.dir_id");
+    if (!m_db->exec(query)) {
+        m_db->logSqlError(query);
+        return;
+    }
+
+    QVector<Record> records;
+    QByteArray pool;
+    QHash<qint64, quint32> directories;
+    while (m_db->next(query)) {
+        Record record;
+        memset(&record, 0, sizeof(record));
+
+        qint64 dirId = query.value(1).toLongLong();
+        if (!directories.contains(dirId))
+            directories.insert(dirId, appendString(&pool, query.value(2).toString()));
+
+        record.id = query.value(0).toLongLong();
+        record.directory = directories.value(dirId);
+        record.basename = appendString(&pool, query.value(3).toString());
+        record.width = query.value(4).toInt();
+        record.height = query.value(5).toInt();
+        record.timestamp = query.value(6).toLongLong();
+        record.exposureTime = query.value(7).toLongLong();
+        record.orientation = query.value(8).toInt();
+        record.filesize = query.value(9).toLongLong();
+        record.mediaType = query.value(10).toInt();
+        record.placeholderColor = query.value(11).toLongLong();
+        records.append(record);
+    }
+    query.finish();
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.format = SNAPSHOT_FORMAT;
+    header.schemaVersion = m_schemaVersion;
+    header.count = records.size();
+    header.poolSize = pool.size();
+
+    QFile file(m_fileName + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Could not write library snapshot" << file.fileName();
+        return;
+    }
+
+    qint64 size = qint64(sizeof(header)) + qint64(records.size()) * qint64(sizeof(Record)) +
+            pool.size();
+    qint64 written = file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    written += file.write(reinterpret_cast<const char*>(records.constData()),
+                          records.size() * sizeof(Record));
+    written += file.write(pool);
+    file.close();
+
+    QMutexLocker locker(&m_mutex);
+    if (written != size || changes != m_changes || m_changesInProgress > 0) {
+        file.remove();
+        return;
+    }
+
+    removeFile();
+    if (!file.rename(m_fileName)) {
+        qDebug() << "Could not replace library snapshot" << m_fileName;
+        file.remove();
+        return;
+    }
+    m_exists = true;
+}
+
+/*!
+ * \brief LibrarySnapshot::removeFile has to be called with the mutex locked
+ */
+void LibrarySnapshot::removeFile()
+{
+    if (!m_exists)
+        return;
+
+    QFile::remove(m_fileName);
+    m_exists = false;
+}
+
+/*!
+ * \brief LibrarySnapshotWorker::LibrarySnapshotWorker
+ * \param snapshot
+ * \param parent
+ */
+LibrarySnapshotWorker::LibrarySnapshotWorker(LibrarySnapshot *snapshot, QObject *parent)
+    : QObject(parent),
+      m_snapshot(snapshot),
+      m_writeTimer(this)
+{
+    m_writeTimer.setInterval(WRITE_DELAY);
+    m_writeTimer.setSingleShot(true);
+    QObject::connect(&m_writeTimer, SIGNAL(timeout()), this, SLOT(onWriteTimeout()));
+}
+
+/*!
+ * \brief LibrarySnapshotWorker::scheduleWrite (re)starts waiting for the
+ * changes to stop
+ */
+void LibrarySnapshotWorker::scheduleWrite()
+{
+    m_writeTimer.start();
+}
+
+/*!
+ * \brief LibrarySnapshotWorker::onWriteTimeout
+ */
+void LibrarySnapshotWorker::onWriteTimeout()
+{
+    m_snapshot->write();
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBRARYSNAPSHOT_H
+#define LIBRARYSNAPSHOT_H
+
+// media
+#include "media-source.h"
+
+// util
+#include "orientation.h"
+
+#include <QColor>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSize>
+#include <QThread>
+#include <QTimer>
+
+class Database;
+class LibrarySnapshotWorker;
+
+/*!
+ * \brief The LibrarySnapshot class is a copy of all rows of the MediaTable in
+ * a binary file, that is memory mapped to load the library at startup
+ * without going through SQL.
+ * The database stays the only place that gets written. Every change of the
+ * media removes the snapshot, and a new one is written in the background
+ * once the changes stopped.
+ */
+class LibrarySnapshot : public QObject
+{
+    Q_OBJECT
+
+public:
+    LibrarySnapshot(Database *db, const QString& fileName, int schemaVersion,
+                    QObject *parent = 0);
+    virtual ~LibrarySnapshot();
+
+    bool open();
+    int count() const;
+    void read(int index, qint64 *mediaId, QString *filename, QSize *size,
+              QDateTime *timestamp, QDateTime *exposureTime,
+              Orientation *originalOrientation, qint64 *filesize,
+              QColor *placeholderColor, MediaSource::MediaType *mediaType);
+    void close();
+
+    void beginChange();
+    void endChange();
+    void invalidate();
+    void scheduleWrite();
+
+    void write();
+
+private:
+    struct Header;
+    struct Record;
+
+    QString string(quint32 offset) const;
+    void removeFile();
+
+    Database *m_db;
+    QString m_fileName;
+    int m_schemaVersion;
+    QFile m_file;
+    const uchar *m_data;
+    const Record *m_records;
+    const uchar *m_pool;
+    int m_count;
+    quint32 m_poolSize;
+    QHash<quint32, QString> m_directories;
+    QMutex m_mutex;
+    int m_changes;
+    int m_changesInProgress;
+    bool m_writePending;
+    bool m_exists;
+    LibrarySnapshotWorker *m_worker;
+    QThread m_workerThread;
+};
+
+/*!
+ * \brief The LibrarySnapshotWorker class writes the snapshot in a thread
+ */
+class LibrarySnapshotWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LibrarySnapshotWorker(LibrarySnapshot *snapshot, QObject *parent = 0);
+
+public slots:
+    void scheduleWrite();
+    void onWriteTimeout();
+
+private:
+    // Time without changes, before the snapshot is written
+    static const int WRITE_DELAY;
+
+    LibrarySnapshot *m_snapshot;
+    QTimer m_writeTimer;
+};
+
+#endif // LIBRARYSNAPSHOT_H
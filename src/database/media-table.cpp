@@ -19,9 +19,12 @@
 
 #include "media-table.h"
 #include "database.h"
+#include "database-writer.h"
+#include "library-snapshot.h"
 #include "resource.h"
 
 #include <QApplication>
+#include <QMutexLocker>
 #include <QtSql>
 
 /*!
@@ -41,18 +44,29 @@ MediaTable::MediaTable(Database* db, Resource *resource, QObject* parent)
  */
 qint64 MediaTable::getIdForMedia(const QString& filename)
 {
+    // A removal of the same file might still be pending
+    m_db->getWriter()->flush();
+
+    QString directory;
+    QString basename;
+    splitFilename(filename, &directory, &basename);
+
     // If there's a row for this file, return the ID.
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT id FROM MediaTable WHERE filename = :filename");
-    query.bindValue(":filename", filename);
-    if (!query.exec())
+    QSqlQuery query = m_db->prepare("SELECT m.id FROM MediaTable m JOIN DirectoryTable d "
+                                    "ON d.id = m.dir_id WHERE d.path = :path AND "
+                                    "m.basename = :basename");
+    query.bindValue(":path", directory);
+    query.bindValue(":basename", basename);
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
-    if (query.next())
-        return query.value(0).toLongLong();
+    // -1 if no row is found.
+    qint64 id = -1;
+    if (m_db->next(query))
+        id = query.value(0).toLongLong();
+    query.finish();
 
-    // No row found.
-    return -1;
+    return id;
 }
 
 /*!
@@ -62,26 +76,39 @@ qint64 MediaTable::getIdForMedia(const QString& filename)
  * \param exposureTime
  * \param originalOrientation
  * \param filesize
+ * \param mediaType
  * \return
  */
 qint64 MediaTable::createIdForMedia(const QString& filename,
                                        const QDateTime& timestamp, const QDateTime& exposureTime,
-                                       Orientation originalOrientation, qint64 filesize, QSize size)
+                                       Orientation originalOrientation, qint64 filesize, QSize size,
+                                       MediaSource::MediaType mediaType)
 {
+    QString directory;
+    QString basename;
+    splitFilename(filename, &directory, &basename);
+
+    QMutexLocker locker(m_db->writeLock());
+    qint64 dirId = directoryId(directory);
+
     // Add the row.
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("INSERT INTO MediaTable (filename, timestamp, exposure_time, "
-                  "original_orientation, filesize, width, height) VALUES (:filename, :timestamp, "
-                  ":exposure_time, :original_orientation, :filesize, :width, :height)");
-    query.bindValue(":filename", filename);
+    QSqlQuery query = m_db->prepare("INSERT INTO MediaTable (dir_id, basename, timestamp, exposure_time, "
+                                    "original_orientation, filesize, width, height, media_type) VALUES "
+                                    "(:dir_id, :basename, :timestamp, :exposure_time, :original_orientation, "
+                                    ":filesize, :width, :height, :media_type)");
+    query.bindValue(":dir_id", dirId);
+    query.bindValue(":basename", basename);
     query.bindValue(":timestamp", timestamp.toMSecsSinceEpoch());
     query.bindValue(":exposure_time", exposureTime.toMSecsSinceEpoch());
     query.bindValue(":original_orientation", originalOrientation);
     query.bindValue(":filesize", filesize);
     query.bindValue(":width", size.width());
     query.bindValue(":height", size.height());
-    if (!query.exec())
+    query.bindValue(":media_type", mediaType);
+    m_db->getSnapshot()->beginChange();
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
+    m_db->getSnapshot()->endChange();
 
     return query.lastInsertId().toLongLong();
 }
@@ -99,20 +126,29 @@ void MediaTable::updateMedia(qint64 mediaId, const QString& filename,
                               const QDateTime& timestamp, const QDateTime& exposureTime,
                               Orientation originalOrientation, qint64 filesize)
 {
+    QString directory;
+    QString basename;
+    splitFilename(filename, &directory, &basename);
+
+    QMutexLocker locker(m_db->writeLock());
+    qint64 dirId = directoryId(directory);
+
     // Add the row.
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE MediaTable SET filename = :filename, "
-                  "timestamp = :timestamp, exposure_time = :exposure_time, "
-                  "original_orientation = :original_orientation, "
-                  "filesize = :filesize WHERE id = :id");
-    query.bindValue(":filename", filename);
+    QSqlQuery query = m_db->prepare("UPDATE MediaTable SET dir_id = :dir_id, basename = :basename, "
+                                    "timestamp = :timestamp, exposure_time = :exposure_time, "
+                                    "original_orientation = :original_orientation, "
+                                    "filesize = :filesize WHERE id = :id");
+    query.bindValue(":dir_id", dirId);
+    query.bindValue(":basename", basename);
     query.bindValue(":timestamp", timestamp.toMSecsSinceEpoch());
     query.bindValue(":exposure_time", exposureTime.toMSecsSinceEpoch());
     query.bindValue(":original_orientation", originalOrientation);
     query.bindValue(":filesize", filesize);
     query.bindValue(":id", mediaId);
-    if (!query.exec())
+    m_db->getSnapshot()->beginChange();
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
+    m_db->getSnapshot()->endChange();
 }
 
 /*!
@@ -121,11 +157,117 @@ void MediaTable::updateMedia(qint64 mediaId, const QString& filename,
  */
 void MediaTable::remove(qint64 mediaId)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("DELETE FROM MediaTable WHERE id = :id");
+    QVariantMap values;
+    values.insert(":id", mediaId);
+    m_db->getSnapshot()->invalidate();
+    m_db->getWriter()->enqueue(QString("MediaTable.remove/%1").arg(mediaId),
+                               "DELETE FROM MediaTable WHERE id = :id", values);
+}
+
+/*!
+ * \brief MediaTable::setFilename Changes the file of a photo, used when the
+ * file got renamed or moved
+ * \param mediaId
+ * \param filename
+ */
+void MediaTable::setFilename(qint64 mediaId, const QString& filename)
+{
+    QString directory;
+    QString basename;
+    splitFilename(filename, &directory, &basename);
+
+    QMutexLocker locker(m_db->writeLock());
+    qint64 dirId = directoryId(directory);
+
+    QSqlQuery query = m_db->prepare("UPDATE MediaTable SET dir_id = :dir_id, basename = :basename "
+                                    "WHERE id = :id");
     query.bindValue(":id", mediaId);
-    if (!query.exec())
+    query.bindValue(":dir_id", dirId);
+    query.bindValue(":basename", basename);
+    m_db->getSnapshot()->beginChange();
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
+    m_db->getSnapshot()->endChange();
+}
+
+/*!
+ * \brief MediaTable::setContentHash
+ * \param mediaId
+ * \param contentHash
+ */
+void MediaTable::setContentHash(qint64 mediaId, const QByteArray& contentHash)
+{
+    QVariantMap values;
+    values.insert(":id", mediaId);
+    values.insert(":content_hash", contentHash);
+    m_db->getWriter()->enqueue(QString("MediaTable.contentHash/%1").arg(mediaId),
+                               "UPDATE MediaTable SET content_hash = :content_hash "
+                               "WHERE id = :id", values);
+}
+
+/*!
+ * \brief MediaTable::getMediaWithContentHash finds the media with the same
+ * content as a file, which might be the same file under another path
+ * \param contentHash
+ * \return the filenames of the media, by their ID
+ */
+QHash<qint64, QString> MediaTable::getMediaWithContentHash(const QByteArray& contentHash)
+{
+    m_db->getWriter()->flush();
+
+    QSqlQuery query = m_db->prepare("SELECT m.id, d.path, m.basename FROM MediaTable m "
+                                    "JOIN DirectoryTable d ON d.id = m.dir_id "
+                                    "WHERE m.content_hash = :content_hash");
+    query.bindValue(":content_hash", contentHash);
+    if (!m_db->exec(query))
+        m_db->logSqlError(query);
+
+    QHash<qint64, QString> media;
+    while (m_db->next(query))
+        media.insert(query.value(0).toLongLong(), query.value(1).toString() + query.value(2).toString());
+    query.finish();
+
+    return media;
+}
+
+/*!
+ * \brief MediaTable::setPlaceholderColor
+ * \param mediaId
+ * \param placeholderColor an invalid color removes it
+ */
+void MediaTable::setPlaceholderColor(qint64 mediaId, const QColor& placeholderColor)
+{
+    QVariantMap values;
+    values.insert(":id", mediaId);
+    values.insert(":placeholder_color", placeholderColor.isValid() ?
+                      QVariant(qint64(placeholderColor.rgba())) : QVariant());
+    m_db->getSnapshot()->invalidate();
+    m_db->getWriter()->enqueue(QString("MediaTable.placeholderColor/%1").arg(mediaId),
+                               "UPDATE MediaTable SET placeholder_color = :placeholder_color "
+                               "WHERE id = :id", values);
+}
+
+/*!
+ * \brief MediaTable::getPlaceholderColor
+ * \param mediaId
+ * \return an invalid color if the media has none
+ */
+QColor MediaTable::getPlaceholderColor(qint64 mediaId)
+{
+    m_db->getWriter()->flush();
+
+    QSqlQuery query = m_db->prepare("SELECT placeholder_color FROM MediaTable "
+                                    "WHERE id = :id LIMIT 1");
+    query.bindValue(":id", mediaId);
+    if (!m_db->exec(query))
+        m_db->logSqlError(query);
+
+    QColor placeholderColor;
+    if (m_db->next(query) && !query.value(0).isNull())
+        placeholderColor = QColor::fromRgba(query.value(0).toLongLong());
+    query.finish();
+
+    return placeholderColor;
 }
 
 /*!
@@ -135,19 +277,19 @@ void MediaTable::remove(qint64 mediaId)
  */
 QSize MediaTable::getMediaSize(qint64 mediaId)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT width, height FROM MediaTable WHERE id = :id LIMIT 1");
+    QSqlQuery query = m_db->prepare("SELECT width, height FROM MediaTable WHERE id = :id LIMIT 1");
     query.bindValue(":id", mediaId);
-    if (!query.exec())
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
     QSize size;
-    if (query.next()) {
+    if (m_db->next(query)) {
         int width = query.value(0).toInt();
         int height = query.value(1).toInt();
         if (width > 0 && height > 0)
             size = QSize(width, height);
     }
+    query.finish();
 
     return size;
 }
@@ -159,14 +301,14 @@ QSize MediaTable::getMediaSize(qint64 mediaId)
  */
 void MediaTable::setMediaSize(qint64 mediaId, const QSize& size)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE MediaTable SET width = :width, height = :height "
-                  "WHERE id = :id");
-    query.bindValue(":id", mediaId);
-    query.bindValue(":width", size.width());
-    query.bindValue(":height", size.height());
-    if (!query.exec())
-        m_db->logSqlError(query);
+    QVariantMap values;
+    values.insert(":id", mediaId);
+    values.insert(":width", size.width());
+    values.insert(":height", size.height());
+    m_db->getSnapshot()->invalidate();
+    m_db->getWriter()->enqueue(QString("MediaTable.size/%1").arg(mediaId),
+                               "UPDATE MediaTable SET width = :width, height = :height "
+                               "WHERE id = :id", values);
 }
 
 /*!
@@ -176,12 +318,13 @@ void MediaTable::setMediaSize(qint64 mediaId, const QSize& size)
  */
 void MediaTable::setOriginalOrientation(qint64 mediaId, const Orientation& orientation)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("UPDATE MediaTable SET orientation = :orientation WHERE id = :id");
-    query.bindValue(":id", mediaId);
-    query.bindValue(":orientation", orientation);
-    if (!query.exec())
-        m_db->logSqlError(query);
+    QVariantMap values;
+    values.insert(":id", mediaId);
+    values.insert(":original_orientation", orientation);
+    m_db->getSnapshot()->invalidate();
+    m_db->getWriter()->enqueue(QString("MediaTable.orientation/%1").arg(mediaId),
+                               "UPDATE MediaTable SET original_orientation = :original_orientation "
+                               "WHERE id = :id", values);
 }
 
 /*!
@@ -191,16 +334,16 @@ void MediaTable::setOriginalOrientation(qint64 mediaId, const Orientation& orien
  */
 QDateTime MediaTable::getFileTimestamp(qint64 mediaId)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT timestamp FROM MediaTable WHERE id = :id");
+    QSqlQuery query = m_db->prepare("SELECT timestamp FROM MediaTable WHERE id = :id");
     query.bindValue(":id", mediaId);
-    if (!query.exec())
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
     QDateTime timestamp;
-    if (query.next()) {
+    if (m_db->next(query)) {
         timestamp.setMSecsSinceEpoch(query.value(0).toLongLong());
     }
+    query.finish();
 
     return timestamp;
 }
@@ -212,16 +355,16 @@ QDateTime MediaTable::getFileTimestamp(qint64 mediaId)
  */
 QDateTime MediaTable::getExposureTime(qint64 mediaId)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT exposure_time FROM MediaTable WHERE id = :id");
+    QSqlQuery query = m_db->prepare("SELECT exposure_time FROM MediaTable WHERE id = :id");
     query.bindValue(":id", mediaId);
-    if (!query.exec())
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
     QDateTime exposure_time;
-    if (query.next()) {
+    if (m_db->next(query)) {
         exposure_time.setMSecsSinceEpoch(query.value(0).toLongLong());
     }
+    query.finish();
 
     return exposure_time;
 }
@@ -242,9 +385,9 @@ void MediaTable::removeBlacklistedRows()
     // Expand current regular expressions to use existing external drives
     QStringList replacedRegExpList;
     foreach (const QString& regExp, m_resource->blacklistedDirectories()) {
-        // If regular expression is a valid path add that to the support LIKE format
+        // If regular expression is a valid path, remove everything below it
         if (QDir(regExp).exists()) {
-            replacedRegExpList << regExp + "%";
+            replacedRegExpList << (regExp.endsWith("/") ? regExp : regExp + "/");
             continue;
         }
 
@@ -257,38 +400,142 @@ void MediaTable::removeBlacklistedRows()
             replacedRegExp.replace("/media/" + qgetenv("USER") + "/[^/]*", "/media/" + qgetenv("USER") + "/" + extDrive);
 
             if (replacedRegExp.endsWith("/")) {
-                replacedRegExpList << replacedRegExp + "%";
+                replacedRegExpList << replacedRegExp;
             } else {
-                replacedRegExpList << replacedRegExp + "/%";
+                replacedRegExpList << replacedRegExp + "/";
             }
         }
     }
 
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("DELETE FROM MediaTable WHERE filename LIKE :blacklisted");
+    foreach (const QString &blacklisted, replacedRegExpList)
+        removeDirectory(blacklisted);
+}
 
-    foreach (const QString &blacklisted, replacedRegExpList) {
-        query.bindValue(":blacklisted", blacklisted);
-        if (!query.exec()) {
-            m_db->logSqlError(query);
-        }
-    }
+/*!
+ * \brief MediaTable::removeDirectory removes all media in the directory and
+ * its sub directories
+ * \param directory has to end with a '/'
+ */
+void MediaTable::removeDirectory(const QString& directory)
+{
+    // All paths starting with "directory/" sort before "directory0"
+    QString first = directory;
+    QString last = directory.left(directory.length() - 1) + QChar('/' + 1);
+
+    QMutexLocker locker(m_db->writeLock());
+    QSqlDatabase *db = m_db->getDB();
+    db->transaction();
+
+    QSqlQuery query = m_db->prepare("DELETE FROM MediaTable WHERE dir_id IN "
+                                    "(SELECT id FROM DirectoryTable WHERE "
+                                    "path >= :first AND path < :last)");
+    query.bindValue(":first", first);
+    query.bindValue(":last", last);
+    if (!m_db->exec(query))
+        m_db->logSqlError(query);
+
+    QSqlQuery dirQuery = m_db->prepare("DELETE FROM DirectoryTable WHERE "
+                                       "path >= :first AND path < :last");
+    dirQuery.bindValue(":first", first);
+    dirQuery.bindValue(":last", last);
+    if (!m_db->exec(dirQuery))
+        m_db->logSqlError(dirQuery);
+
+    // This runs on every start, mostly without removing anything. Keep the
+    // snapshot in that case.
+    bool removed = query.numRowsAffected() > 0;
+    if (removed)
+        m_db->getSnapshot()->beginChange();
+    if (!db->commit())
+        qDebug() << "SQLite error: " << db->lastError();
+    if (removed)
+        m_db->getSnapshot()->endChange();
+}
+
+/*!
+ * \brief MediaTable::splitFilename
+ * \param filename
+ * \param directory gets the directory, ending with a '/'
+ * \param basename gets the name of the file in the directory
+ */
+void MediaTable::splitFilename(const QString& filename, QString* directory, QString* basename)
+{
+    int separator = filename.lastIndexOf('/');
+    *directory = filename.left(separator + 1);
+    *basename = filename.mid(separator + 1);
+}
+
+/*!
+ * \brief MediaTable::directoryId returns the ID of the directory, adds it if
+ * needed. Has to be called with the write lock held.
+ * \param directory
+ * \return
+ */
+qint64 MediaTable::directoryId(const QString& directory)
+{
+    QSqlQuery insert = m_db->prepare("INSERT OR IGNORE INTO DirectoryTable (path) VALUES (:path)");
+    insert.bindValue(":path", directory);
+    if (!m_db->exec(insert))
+        m_db->logSqlError(insert);
+
+    QSqlQuery query = m_db->prepare("SELECT id FROM DirectoryTable WHERE path = :path");
+    query.bindValue(":path", directory);
+    if (!m_db->exec(query))
+        m_db->logSqlError(query);
+
+    qint64 id = INVALID_ID;
+    if (m_db->next(query))
+        id = query.value(0).toLongLong();
+    query.finish();
+
+    return id;
 }
 
 /*!
  * \brief MediaTable::emitAllRows goes through the whole DB and emits a row() signal
- * for every single row with all the Database
+ * for every single row with all the Database. The rows are read from the
+ * library snapshot, if there is one.
+ * \param mediaType only rows of that type are emitted, or all for MediaSource::None
  */
-void MediaTable::emitAllRows()
+void MediaTable::emitAllRows(MediaSource::MediaType mediaType)
 {
     removeBlacklistedRows();
 
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT * FROM MediaTable");
-    if (!query.exec())
+    LibrarySnapshot *snapshot = m_db->getSnapshot();
+    if (snapshot->open()) {
+        qint64 id;
+        QString filename;
+        QSize size;
+        QDateTime timestamp;
+        QDateTime exposuretime;
+        Orientation orientation;
+        qint64 filesize;
+        QColor placeholderColor;
+        MediaSource::MediaType type;
+        for (int i = 0; i < snapshot->count(); i++) {
+            snapshot->read(i, &id, &filename, &size, &timestamp, &exposuretime,
+                           &orientation, &filesize, &placeholderColor, &type);
+            if (mediaType == MediaSource::None || type == mediaType)
+                emit row(id, filename, size, timestamp, exposuretime, orientation, filesize,
+                         placeholderColor);
+        }
+        snapshot->close();
+        return;
+    }
+
+    QString sql("SELECT m.id, d.path || m.basename, m.width, m.height, m.timestamp, "
+                "m.exposure_time, m.original_orientation, m.filesize, m.placeholder_color "
+                "FROM MediaTable m JOIN DirectoryTable d ON d.id = m.dir_id");
+    if (mediaType != MediaSource::None)
+        sql += " WHERE m.media_type = :media_type";
+
+    QSqlQuery query = m_db->prepare(sql);
+    if (mediaType != MediaSource::None)
+        query.bindValue(":media_type", mediaType);
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
-    while (query.next()) {
+    while (m_db->next(query)) {
         qint64 id = query.value(0).toInt();
         QString filename = query.value(1).toString();
         QSize size(query.value(2).toInt(), query.value(3).toInt());
@@ -297,9 +544,96 @@ void MediaTable::emitAllRows()
         QDateTime exposuretime;
         exposuretime.setMSecsSinceEpoch(query.value(5).toLongLong());
         Orientation orientation = static_cast<Orientation>(query.value(6).toInt());
-        qint64 filesize = query.value(7).toInt();
-        emit row(id, filename, size, timestamp, exposuretime, orientation, filesize);
+        qint64 filesize = query.value(7).toLongLong();
+        QColor placeholderColor;
+        if (!query.value(8).isNull())
+            placeholderColor = QColor::fromRgba(query.value(8).toLongLong());
+        emit row(id, filename, size, timestamp, exposuretime, orientation, filesize,
+                 placeholderColor);
     }
+
+    // The next start can use the snapshot
+    snapshot->scheduleWrite();
+}
+
+/*!
+ * \brief MediaTable::getMediaPage returns a page of the media, the newest
+ * first, like they are sorted in the MediaCollection
+ * \param mediaType only media of that type, or all for MediaSource::None
+ * \param offset number of media before the page
+ * \param limit size of the page
+ * \return the IDs of the media on the page
+ */
+QList<qint64> MediaTable::getMediaPage(MediaSource::MediaType mediaType, int offset, int limit)
+{
+    QString sql("SELECT id FROM MediaTable ");
+    if (mediaType != MediaSource::None)
+        sql += "WHERE media_type = :media_type ";
+    sql += "ORDER BY exposure_time DESC, id DESC LIMIT :limit OFFSET :offset";
+
+    QSqlQuery query = m_db->prepare(sql);
+    if (mediaType != MediaSource::None)
+        query.bindValue(":media_type", mediaType);
+    query.bindValue(":limit", limit);
+    query.bindValue(":offset", offset);
+
+    return mediaIds(query);
+}
+
+/*!
+ * \brief MediaTable::getMediaInRange returns the media taken in a time range,
+ * the newest first
+ * \param mediaType only media of that type, or all for MediaSource::None
+ * \param from start of the range
+ * \param to end of the range, not part of it anymore
+ * \return the IDs of the media
+ */
+QList<qint64> MediaTable::getMediaInRange(MediaSource::MediaType mediaType,
+                                          const QDateTime& from, const QDateTime& to)
+{
+    QString sql("SELECT id FROM MediaTable WHERE ");
+    if (mediaType != MediaSource::None)
+        sql += "media_type = :media_type AND ";
+    sql += "exposure_time >= :from AND exposure_time < :to ORDER BY exposure_time DESC, id DESC";
+
+    QSqlQuery query = m_db->prepare(sql);
+    if (mediaType != MediaSource::None)
+        query.bindValue(":media_type", mediaType);
+    query.bindValue(":from", from.toMSecsSinceEpoch());
+    query.bindValue(":to", to.toMSecsSinceEpoch());
+
+    return mediaIds(query);
+}
+
+/*!
+ * \brief MediaTable::getMediaOfDay returns the media taken on one day, the
+ * way the EventCollection groups them
+ * \param mediaType only media of that type, or all for MediaSource::None
+ * \param day
+ * \return the IDs of the media
+ */
+QList<qint64> MediaTable::getMediaOfDay(MediaSource::MediaType mediaType, const QDate& day)
+{
+    return getMediaInRange(mediaType, QDateTime(day), QDateTime(day.addDays(1)));
+}
+
+/*!
+ * \brief MediaTable::mediaIds executes the query
+ * \param query selects the IDs of the media
+ * \return the IDs of all rows
+ */
+QList<qint64> MediaTable::mediaIds(QSqlQuery& query)
+{
+    QList<qint64> ids;
+    if (!m_db->exec(query)) {
+        m_db->logSqlError(query);
+        return ids;
+    }
+
+    while (m_db->next(query))
+        ids.append(query.value(0).toLongLong());
+
+    return ids;
 }
 
 /*!
@@ -309,18 +643,19 @@ void MediaTable::emitAllRows()
  * \param originalOrientation
  * \param fileTimestamp
  * \param exposureDateTime
+ * \param filesize
  */
 void MediaTable::getRow(qint64 mediaId, QSize& size, Orientation& 
-                         originalOrientation, QDateTime& fileTimestamp, QDateTime& exposureDateTime)
+                         originalOrientation, QDateTime& fileTimestamp, QDateTime& exposureDateTime,
+                         qint64& filesize)
 {
-    QSqlQuery query(*m_db->getDB());
-    query.prepare("SELECT width, height, timestamp, exposure_time, "
-                  "original_orientation FROM MediaTable WHERE id = :id LIMIT 1");
+    QSqlQuery query = m_db->prepare("SELECT width, height, timestamp, exposure_time, "
+                                    "original_orientation, filesize FROM MediaTable WHERE id = :id LIMIT 1");
     query.bindValue(":id", mediaId);
-    if (!query.exec())
+    if (!m_db->exec(query))
         m_db->logSqlError(query);
 
-    if (!query.next())
+    if (!m_db->next(query))
         m_db->logSqlError(query);
 
     size = QSize(query.value(0).toInt(), query.value(1).toInt());
@@ -328,4 +663,6 @@ void MediaTable::getRow(qint64 mediaId, QSize& size, Orientation&
     fileTimestamp.setMSecsSinceEpoch(query.value(2).toLongLong());
     exposureDateTime.setMSecsSinceEpoch(query.value(3).toLongLong());
     originalOrientation = static_cast<Orientation>(query.value(4).toInt());
+    filesize = query.value(5).toLongLong();
+    query.finish();
 }
@@ -20,12 +20,20 @@
 #ifndef MEDIATABLE_H
 #define MEDIATABLE_H
 
+// media
+#include "media-source.h"
+
 // util
 #include "orientation.h"
 
+#include <QByteArray>
+#include <QColor>
+#include <QHash>
+#include <QList>
 #include <QObject>
 
 class Database;
+class QSqlQuery;
 class Resource;
 
 /*!
@@ -42,17 +50,26 @@ public:
 
     qint64 createIdForMedia(const QString& filename, const QDateTime& timestamp,
                             const QDateTime& exposureTime, Orientation originalOrientation,
-                            qint64 filesize, QSize size);
+                            qint64 filesize, QSize size, MediaSource::MediaType mediaType);
 
     void updateMedia(qint64 mediaId, const QString& filename,
                       const QDateTime& timestamp, const QDateTime& exposureTime,
                       Orientation originalOrientation, qint64 filesize);
 
     void getRow(qint64 mediaId, QSize& size, Orientation& originalOrientation,
-                 QDateTime& fileTimestamp, QDateTime& exposureDateTime);
+                 QDateTime& fileTimestamp, QDateTime& exposureDateTime,
+                 qint64& filesize);
 
     void remove(qint64 mediaId);
 
+    void setFilename(qint64 mediaId, const QString& filename);
+
+    void setContentHash(qint64 mediaId, const QByteArray& contentHash);
+    QHash<qint64, QString> getMediaWithContentHash(const QByteArray& contentHash);
+
+    void setPlaceholderColor(qint64 mediaId, const QColor& placeholderColor);
+    QColor getPlaceholderColor(qint64 mediaId);
+
     QSize getMediaSize(qint64 mediaId);
     void setMediaSize(qint64 mediaId, const QSize& size);
 
@@ -63,14 +80,25 @@ public:
     QDateTime getExposureTime(qint64 mediaId);
 
     void removeBlacklistedRows();
-    void emitAllRows();
+    void removeDirectory(const QString& directory);
+    void emitAllRows(MediaSource::MediaType mediaType);
+
+    QList<qint64> getMediaPage(MediaSource::MediaType mediaType, int offset, int limit);
+    QList<qint64> getMediaInRange(MediaSource::MediaType mediaType, const QDateTime& from,
+                                  const QDateTime& to);
+    QList<qint64> getMediaOfDay(MediaSource::MediaType mediaType, const QDate& day);
 
 signals:
     void row(qint64 mediaId, const QString& filename, const QSize& size,
              const QDateTime& timestamp, const QDateTime& exposureTime,
-             Orientation originalOrientation, qint64 filesize);
+             Orientation originalOrientation, qint64 filesize,
+             const QColor& placeholderColor);
 
 private:
+    static void splitFilename(const QString& filename, QString* directory, QString* basename);
+    qint64 directoryId(const QString& directory);
+    QList<qint64> mediaIds(QSqlQuery& query);
+
     Database* m_db;
     Resource* m_resource;
 };
@@ -44,6 +44,9 @@
 #include "qml-event-overview-model.h"
 #include "qml-media-collection-model.h"
 
+// thumbnail
+#include "thumbnail-provider.h"
+
 // util
 #include "command-line-parser.h"
 #include "urlhandler.h"
@@ -107,6 +110,8 @@ GalleryApplication::GalleryApplication(int& argc, char** argv)
     registerQML();
 
     m_galleryManager = new GalleryManager(isDesktopMode(), m_cmdLineParser->picturesDir());
+    if (m_cmdLineParser->slowQueryTime() >= 0)
+        m_galleryManager->logQueries(m_cmdLineParser->slowQueryTime());
     if (m_cmdLineParser->pickModeEnabled())
         setDefaultUiMode(GalleryApplication::PickContentMode);
 
@@ -236,6 +241,9 @@ void GalleryApplication::createView()
     // Set ourselves up to expose functionality to run external commands from QML...
     m_view->engine()->rootContext()->setContextProperty("APP", this);
 
+    m_view->engine()->addImageProvider(ThumbnailProvider::PROVIDER_ID,
+                                       new ThumbnailProvider(m_galleryManager->thumbnailCache()));
+
     m_view->setSource(Resource::getRcUrl("qml/GalleryApplication.qml"));
     QObject::connect(m_view->engine(), SIGNAL(quit()), this, SLOT(quit()));
 
@@ -36,9 +36,15 @@
 #include "media-collection.h"
 #include "media-monitor.h"
 
+// photo
+#include "photo.h"
+
 // qml
 #include "qml-media-collection-model.h"
 
+// thumbnail
+#include "thumbnail-cache.h"
+
 // util
 #include "resource.h"
 
@@ -58,6 +64,7 @@ GalleryManager::GalleryManager(bool desktopMode,
                                const QString& picturesDir)
     : collectionsInitialised(false),
       m_resource(new Resource(desktopMode, picturesDir)),
+      m_thumbnailCache(new ThumbnailCache(m_resource->thumbnailDirectory())),
       m_database(0),
       m_defaultTemplate(0),
       m_mediaCollection(0),
@@ -65,10 +72,12 @@ GalleryManager::GalleryManager(bool desktopMode,
       m_eventCollection(0),
       m_monitor(0),
       m_desktopMode(desktopMode),
+      m_slowQueryTime(-1),
       m_objectsReadyToAddTimer(this),
       m_mediaLibrary(0)
 {
     m_mediaFactory = new MediaObjectFactory(m_desktopMode, m_resource);
+    m_mediaFactory->setThumbnailCache(m_thumbnailCache);
 
     QObject::connect(m_mediaFactory, SIGNAL(mediaObjectCreated(MediaSource*)),
                      this, SLOT(onMediaObjectCreated(MediaSource*)));
@@ -95,6 +104,7 @@ GalleryManager::~GalleryManager()
     delete m_eventCollection;
     delete m_database;
     delete m_defaultTemplate;
+    delete m_thumbnailCache;
     delete m_resource;
     delete m_mediaCollection;
 }
@@ -139,6 +149,8 @@ void GalleryManager::postInit()
         Exiv2::LogMsg::setLevel(Exiv2::LogMsg::mute);
 
         m_database = new Database(m_resource);
+        if (m_slowQueryTime >= 0)
+            m_database->setQueryLogging(m_slowQueryTime);
         m_mediaFactory->setMediaTable(m_database->getMediaTable());
         m_defaultTemplate = new AlbumDefaultTemplate();
         m_mediaCollection = new MediaCollection(m_database->getMediaTable());
@@ -157,6 +169,16 @@ void GalleryManager::postInit()
     }
 }
 
+/*!
+ * \brief GalleryManager::logQueries collect statistics of the SQL queries,
+ * has to be called before postInit()
+ * \param slowQueryTime queries slower than that (in milliseconds) are logged
+ */
+void GalleryManager::logQueries(int slowQueryTime)
+{
+    m_slowQueryTime = slowQueryTime;
+}
+
 /*!
  * \brief GalleryManager::albumCollection returns the collection of all albums
  * \return
@@ -236,8 +258,14 @@ void GalleryManager::startFileMonitoring()
                      this, SLOT(onMediaItemAdded(QString, int)));
     QObject::connect(m_monitor, SIGNAL(mediaItemRemoved(qint64)),
                      this, SLOT(onMediaItemRemoved(qint64)));
+    QObject::connect(m_monitor, SIGNAL(mediaItemChanged(QString)),
+                     this, SLOT(onMediaItemChanged(QString)));
+    QObject::connect(m_monitor, SIGNAL(mediaItemMoved(qint64, QString)),
+                     this, SLOT(onMediaItemMoved(qint64, QString)));
     QObject::connect(m_monitor, SIGNAL(consistencyCheckFinished()),
                      this, SIGNAL(consistencyCheckFinished()));
+    QObject::connect(m_monitor, SIGNAL(consistencyCheckFinished()),
+                     this, SLOT(onConsistencyCheckFinished()));
 
     m_monitor->startMonitoring(m_resource->mediaDirectories(), m_resource->blacklistedDirectories());
     m_monitor->checkConsistency(m_mediaCollection);
@@ -264,12 +292,64 @@ void GalleryManager::onMediaItemRemoved(qint64 mediaId)
     m_mediaCollection->destroy(mediaId, false);
 }
 
+/*!
+ * \brief GalleryManager::onMediaItemChanged the file of an already known media
+ * got modified, so its metadata needs to be read again
+ * \param file
+ */
+void GalleryManager::onMediaItemChanged(QString file)
+{
+    if (m_mediaCollection->containsFile(file)) {
+        QFileInfo fi(file);
+        m_mediaFactory->create(fi, Qt::HighEventPriority, m_desktopMode, m_resource);
+    }
+}
+
+/*!
+ * \brief GalleryManager::onMediaItemMoved the file of a media got renamed or
+ * moved to another watched folder
+ * \param mediaId
+ * \param file the new file
+ */
+void GalleryManager::onMediaItemMoved(qint64 mediaId, QString file)
+{
+    m_mediaCollection->move(mediaId, QFileInfo(file));
+}
+
+/*!
+ * \brief GalleryManager::onConsistencyCheckFinished all files are known now,
+ * so media whose files are still missing are gone, and not moved
+ */
+void GalleryManager::onConsistencyCheckFinished()
+{
+    m_mediaFactory->removeMissingMedia();
+}
+
 /*!
  * \brief GalleryManager::onMediaObjectCreated
  * \param mediaObject
  */
 void GalleryManager::onMediaObjectCreated(MediaSource *mediaObject)
 {
+    // A refreshed media, update the existing one in place so it keeps its
+    // albums and events
+    MediaSource *existing = m_mediaCollection->mediaForId(mediaObject->id());
+    if (existing && existing != mediaObject) {
+        existing->refresh();
+        existing->setSize(mediaObject->size());
+        existing->setFileTimestamp(mediaObject->fileTimestamp());
+        existing->setExposureDateTime(mediaObject->exposureDateTime());
+        if (mediaObject->placeholderColor().isValid())
+            existing->setPlaceholderColor(mediaObject->placeholderColor());
+
+        Photo *photo = qobject_cast<Photo*>(existing);
+        if (photo)
+            photo->setOriginalOrientation(mediaObject->orientation());
+
+        mediaObject->deleteLater();
+        return;
+    }
+
     m_objectsReadyToAddTimer.start(); 
     if (!m_objectsToAdd.contains(mediaObject)) {
         m_objectsToAdd.insert(mediaObject);
@@ -41,6 +41,7 @@ class MediaMonitor;
 class MediaObjectFactory;
 class QmlMediaCollectionModel;
 class Resource;
+class ThumbnailCache;
 
 /*!
  * Simple class which encapsulates instantiates objects which require only one instance.
@@ -65,8 +66,10 @@ public:
     AlbumCollection *albumCollection();
     EventCollection *eventCollection();
     Resource *resource() { return m_resource; }
+    ThumbnailCache *thumbnailCache() { return m_thumbnailCache; }
 
     void logImageLoading(bool log);
+    void logQueries(int slowQueryTime);
 
     QmlMediaCollectionModel *mediaLibrary() const;
 
@@ -78,6 +81,9 @@ signals:
 private slots:
     void onMediaItemAdded(QString file, int priority);
     void onMediaItemRemoved(qint64 mediaId);
+    void onMediaItemChanged(QString file);
+    void onMediaItemMoved(qint64 mediaId, QString file);
+    void onConsistencyCheckFinished();
     void onMediaObjectCreated(MediaSource *mediaObject);
     void onMediaFromDBLoaded(QSet<DataObject *> mediaFromDB);
     void onObjectsReadyToAdd();
@@ -94,6 +100,7 @@ private:
     bool collectionsInitialised;
 
     Resource* m_resource;
+    ThumbnailCache* m_thumbnailCache;
     Database* m_database;
     AlbumDefaultTemplate* m_defaultTemplate;
     MediaCollection* m_mediaCollection;
@@ -102,6 +109,7 @@ private:
     MediaObjectFactory *m_mediaFactory;
     MediaMonitor *m_monitor;
     bool m_desktopMode;
+    int m_slowQueryTime;
     QTimer m_objectsReadyToAddTimer;
     QSet<DataObject *> m_objectsToAdd;
 
@@ -21,16 +21,28 @@
 #include "media-table.h"
 
 // medialoader
+#include "exif-reader.h"
 #include "photo-metadata.h"
 #include "video-metadata.h"
 
 // photo
 #include "photo.h"
 
+// thumbnail
+#include "thumbnail-cache.h"
+
+// util
+#include "imaging.h"
+
 // video
 #include <video.h>
 
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QFile>
+
+// Bytes read from the start and from the end of a file for its content hash
+static const qint64 CONTENT_HASH_BLOCK_SIZE = 64 * 1024;
 
 QWaitCondition listNotEmptyCondition;
 QMutex createMutex;
@@ -72,6 +84,16 @@ void MediaObjectFactory::setMediaTable(MediaTable *mediaTable)
     m_worker->setMediaTable(mediaTable);
 }
 
+/*!
+ * \brief MediaObjectFactory::setThumbnailCache the thumbnails of moved photos
+ * are kept in it
+ * \param thumbnailCache
+ */
+void MediaObjectFactory::setThumbnailCache(ThumbnailCache *thumbnailCache)
+{
+    m_worker->setThumbnailCache(thumbnailCache);
+}
+
 /*!
  * \brief GalleryManager::enableContentLoadFilter enable filter to load only
  * content of certain type
@@ -99,10 +121,7 @@ void MediaObjectFactory::clear()
 void MediaObjectFactory::create(const QFileInfo &file, int priority, bool desktopMode, Resource *res)
 {
     enqueuePath(file.absoluteFilePath(), priority);
-    if (!m_isRunCreateRunning) {
-        QMetaObject::invokeMethod(m_worker, "runCreate", Qt::QueuedConnection);
-        m_isRunCreateRunning = true;
-    }
+    startRunCreate();
 }
 
 /*!
@@ -117,6 +136,26 @@ void MediaObjectFactory::loadMediaFromDB()
     QMetaObject::invokeMethod(m_worker, "mediaFromDB", Qt::QueuedConnection);
 }
 
+/*!
+ * \brief MediaObjectFactory::removeMissingMedia removes the media whose files
+ * were missing when they were loaded from the DB, and did not show up under
+ * another path since. The files queued before are created first.
+ */
+void MediaObjectFactory::removeMissingMedia()
+{
+    // An empty path in the queue stands for the removal
+    enqueuePath(QString(), Qt::NormalEventPriority);
+    startRunCreate();
+}
+
+void MediaObjectFactory::startRunCreate()
+{
+    if (!m_isRunCreateRunning) {
+        QMetaObject::invokeMethod(m_worker, "runCreate", Qt::QueuedConnection);
+        m_isRunCreateRunning = true;
+    }
+}
+
 void MediaObjectFactory::enqueuePath(const QString &path, int priority)
 {
     createMutex.lock();
@@ -131,6 +170,7 @@ void MediaObjectFactory::enqueuePath(const QString &path, int priority)
 MediaObjectFactoryWorker::MediaObjectFactoryWorker(QObject *parent)
     : QObject(parent),
       m_mediaTable(),
+      m_thumbnailCache(0),
       m_filterType(MediaSource::None)
 {
 }
@@ -151,6 +191,11 @@ void MediaObjectFactoryWorker::runCreate()
         path = createQueue.takeFirst();
         createMutex.unlock();
 
+        if (path.isEmpty()) {
+            removeMissingMedia();
+            continue;
+        }
+
         QFileInfo file(path);
         if(file.exists()) {
             create(path);
@@ -163,6 +208,11 @@ void MediaObjectFactoryWorker::setMediaTable(MediaTable *mediaTable)
     m_mediaTable = mediaTable;
 }
 
+void MediaObjectFactoryWorker::setThumbnailCache(ThumbnailCache *thumbnailCache)
+{
+    m_thumbnailCache = thumbnailCache;
+}
+
 void MediaObjectFactoryWorker::enableContentLoadFilter(MediaSource::MediaType filterType)
 {
     m_filterType = filterType;
@@ -192,6 +242,13 @@ void MediaObjectFactoryWorker::create(const QString &path)
     // Look for video in the database.
     qint64 id = m_mediaTable->getIdForMedia(file.absoluteFilePath());
 
+    QByteArray hash;
+    if (id == INVALID_ID) {
+        // The same content might be known under another path already
+        hash = contentHash(file);
+        id = reuseMedia(file, mediaType, hash);
+    }
+
     if (id == INVALID_ID) {
         if (mediaType == MediaSource::Video && !Video::isValid(file))
             return;
@@ -220,18 +277,33 @@ void MediaObjectFactoryWorker::create(const QString &path)
         }
 
         // This will cause the real size to be read from the file
-        if (photo) m_size = photo->size();
+        if (photo && !m_size.isValid()) m_size = photo->size();
 
         // Add to DB.
         id = m_mediaTable->createIdForMedia(file.absoluteFilePath(), m_timeStamp,
-                                            m_exposureTime, m_orientation, m_fileSize, m_size);
+                                            m_exposureTime, m_orientation, m_fileSize, m_size,
+                                            mediaType);
+        if (!hash.isEmpty())
+            m_mediaTable->setContentHash(id, hash);
+        if (m_placeholderColor.isValid())
+            m_mediaTable->setPlaceholderColor(id, m_placeholderColor);
     } else {
         // Load metadata from DB.
-        m_mediaTable->getRow(id, m_size, m_orientation, m_timeStamp, m_exposureTime);
+        m_mediaTable->getRow(id, m_size, m_orientation, m_timeStamp, m_exposureTime,
+                             m_fileSize);
+        m_placeholderColor = m_mediaTable->getPlaceholderColor(id);
+
+        // The file got rewritten since it was stored, so the row is stale
+        if (fileChanged(file, mediaType, m_timeStamp, m_fileSize) &&
+                !refreshMetadata(id, media)) {
+            delete media;
+            return;
+        }
     }
     media->setSize(m_size);
     media->setFileTimestamp(m_timeStamp);
     media->setExposureDateTime(m_exposureTime);
+    media->setPlaceholderColor(m_placeholderColor);
     if (mediaType == MediaSource::Photo) {
         photo->setOriginalOrientation(m_orientation);
     }
@@ -248,20 +320,30 @@ void MediaObjectFactoryWorker::mediaFromDB()
     m_mediaFromDB.clear();
 
     connect(m_mediaTable,
-            SIGNAL(row(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64)),
+            SIGNAL(row(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64,QColor)),
             this,
-            SLOT(addMedia(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64)));
+            SLOT(addMedia(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64,QColor)));
 
-    m_mediaTable->emitAllRows();
+    m_mediaTable->emitAllRows(m_filterType);
 
     disconnect(m_mediaTable,
-               SIGNAL(row(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64)),
+               SIGNAL(row(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64,QColor)),
                this,
-               SLOT(addMedia(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64)));
+               SLOT(addMedia(qint64,QString,QSize,QDateTime,QDateTime,Orientation,qint64,QColor)));
 
     emit mediaFromDBLoaded(m_mediaFromDB);
 }
 
+/*!
+ * \brief MediaObjectFactoryWorker::removeMissingMedia
+ */
+void MediaObjectFactoryWorker::removeMissingMedia()
+{
+    foreach (qint64 mediaId, m_missingMedia)
+        m_mediaTable->remove(mediaId);
+    m_missingMedia.clear();
+}
+
 /*!
  * \brief MediaObjectFactory::clearMetadata resets all memeber variables
  * regarding metadata
@@ -273,6 +355,7 @@ void MediaObjectFactoryWorker::clearMetadata()
     m_orientation = TOP_LEFT_ORIGIN;
     m_fileSize = 0;
     m_size = QSize();
+    m_placeholderColor = QColor();
 }
 
 /*!
@@ -282,12 +365,29 @@ void MediaObjectFactoryWorker::clearMetadata()
  */
 bool MediaObjectFactoryWorker::readPhotoMetadata(const QFileInfo &file)
 {
-    PhotoMetadata* metadata = PhotoMetadata::fromFile(file);
-
     m_timeStamp = file.lastModified();
     m_fileSize = file.size();
     m_size = QSize();
 
+    // Most photos are JPEG files from a camera, which need no Exiv2. Camera
+    // RAW files are shown through their embedded preview, so they are always
+    // read this way, for the size of the preview.
+    ExifReader reader(file.absoluteFilePath());
+    bool raw = ExifReader::isRawFile(file);
+    bool read = raw ? reader.readRaw() : reader.read();
+    if (read)
+        readPlaceholderColor(reader.thumbnail());
+    if (read && (raw || reader.exposureTime().isValid())) {
+        m_exposureTime = reader.exposureTime().isValid() ? reader.exposureTime() : m_timeStamp;
+        m_orientation = reader.orientation();
+        m_size = reader.size();
+        if (m_orientation >= LEFT_TOP_ORIGIN)
+            m_size.transpose();
+        return true;
+    }
+
+    PhotoMetadata* metadata = PhotoMetadata::fromFile(file);
+
     if (metadata != 0 && metadata->exposureTime().isValid()) {
         m_exposureTime = QDateTime(metadata->exposureTime());
     } else {
@@ -308,6 +408,24 @@ bool MediaObjectFactoryWorker::readPhotoMetadata(const QFileInfo &file)
     return true;
 }
 
+/*!
+ * \brief MediaObjectFactoryWorker::readPlaceholderColor computes the average
+ * color of a photo from its Exif thumbnail. That is decoded in no time, and is
+ * already read with the Exif data.
+ * \param thumbnail
+ */
+void MediaObjectFactoryWorker::readPlaceholderColor(const QByteArray &thumbnail)
+{
+    if (thumbnail.isEmpty())
+        return;
+
+    QImage image = QImage::fromData(thumbnail, "JPG");
+    if (image.isNull())
+        return;
+
+    m_placeholderColor = QColor(scaleAndOrient(image, QSize(1, 1), TOP_LEFT_ORIGIN).pixel(0, 0));
+}
+
 /*!
  * \brief MediaObjectFactory::readVideoMetadata
  * \param file
@@ -340,6 +458,150 @@ bool MediaObjectFactoryWorker::readVideoMetadata(const QFileInfo &file)
     return true;
 }
 
+/*!
+ * \brief MediaObjectFactoryWorker::fileChanged compares the file on disk with
+ * the fingerprint (file size and timestamp) stored in the database
+ * \param file
+ * \param mediaType
+ * \param timestamp the timestamp stored for the file
+ * \param filesize the file size stored for the file
+ * \return true if the file was modified after the fingerprint was stored
+ */
+bool MediaObjectFactoryWorker::fileChanged(const QFileInfo &file,
+                                           MediaSource::MediaType mediaType,
+                                           const QDateTime &timestamp,
+                                           qint64 filesize) const
+{
+    // Rows created before the fingerprint was stored can't be checked
+    if (filesize <= 0 || !timestamp.isValid())
+        return false;
+
+    if (file.size() != filesize)
+        return true;
+
+    // Same timestamp source as used by readPhotoMetadata() / readVideoMetadata()
+    const QDateTime current = (mediaType == MediaSource::Video) ?
+                file.created() : file.lastModified();
+    return current.toMSecsSinceEpoch() != timestamp.toMSecsSinceEpoch();
+}
+
+/*!
+ * \brief MediaObjectFactoryWorker::refreshMetadata reads the metadata of a
+ * media again, and updates the existing row in the DB with it. The ID of the
+ * media stays the same, so album memberships are kept.
+ * \param mediaId
+ * \param media
+ * \return false if the metadata could not be read anymore
+ */
+bool MediaObjectFactoryWorker::refreshMetadata(qint64 mediaId, MediaSource *media)
+{
+    clearMetadata();
+
+    Photo *photo = qobject_cast<Photo*>(media);
+    if (photo) {
+        readPhotoMetadata(media->file());
+        // This will cause the real size to be read from the file
+        if (!m_size.isValid())
+            m_size = photo->size();
+    } else if (!readVideoMetadata(media->file())) {
+        return false;
+    }
+
+    m_mediaTable->updateMedia(mediaId, media->file().absoluteFilePath(), m_timeStamp,
+                              m_exposureTime, m_orientation, m_fileSize);
+    m_mediaTable->setMediaSize(mediaId, m_size);
+    m_mediaTable->setContentHash(mediaId, contentHash(media->file()));
+    if (photo)
+        m_mediaTable->setPlaceholderColor(mediaId, m_placeholderColor);
+
+    return true;
+}
+
+/*!
+ * \brief MediaObjectFactoryWorker::contentHash hashes the size, the start and
+ * the end of a file. That's cheap even for big videos, and tells media files
+ * apart as well as hashing all of it.
+ * \param file
+ * \return empty if the file can't be read
+ */
+QByteArray MediaObjectFactoryWorker::contentHash(const QFileInfo &file)
+{
+    QFile content(file.absoluteFilePath());
+    if (!content.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    qint64 size = content.size();
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(QByteArray::number(size));
+    hash.addData(content.read(CONTENT_HASH_BLOCK_SIZE));
+    if (size > CONTENT_HASH_BLOCK_SIZE) {
+        content.seek(qMax(size - CONTENT_HASH_BLOCK_SIZE, CONTENT_HASH_BLOCK_SIZE));
+        hash.addData(content.read(CONTENT_HASH_BLOCK_SIZE));
+    }
+
+    return hash.result();
+}
+
+/*!
+ * \brief MediaObjectFactoryWorker::reuseMedia looks for media with the same
+ * content as a new file, to skip reading its metadata.
+ * If the file of such a media was missing when it was loaded from the DB, the
+ * media was moved, or its storage mounted at another path. Its row is
+ * updated to the new path, so it keeps its ID, albums and thumbnails.
+ * Otherwise the file is a copy, and gets a new row with the same metadata.
+ * \param file
+ * \param mediaType
+ * \param contentHash
+ * \return the ID of the row for the file, INVALID_ID if there is no such
+ * media
+ */
+qint64 MediaObjectFactoryWorker::reuseMedia(const QFileInfo &file,
+                                            MediaSource::MediaType mediaType,
+                                            const QByteArray &contentHash)
+{
+    if (contentHash.isEmpty())
+        return INVALID_ID;
+
+    QHash<qint64, QString> media = m_mediaTable->getMediaWithContentHash(contentHash);
+    if (media.isEmpty())
+        return INVALID_ID;
+
+    qint64 id = media.constBegin().key();
+    foreach (qint64 mediaId, media.keys()) {
+        if (m_missingMedia.contains(mediaId)) {
+            id = mediaId;
+            break;
+        }
+    }
+
+    QSize size;
+    Orientation orientation = TOP_LEFT_ORIGIN;
+    QDateTime timestamp;
+    QDateTime exposureTime;
+    qint64 filesize = 0;
+    m_mediaTable->getRow(id, size, orientation, timestamp, exposureTime, filesize);
+
+    // Same timestamp source as used by readPhotoMetadata() / readVideoMetadata()
+    const QDateTime newTimestamp = (mediaType == MediaSource::Video) ?
+                file.created() : file.lastModified();
+
+    if (!m_missingMedia.remove(id)) {
+        qint64 newId = m_mediaTable->createIdForMedia(file.absoluteFilePath(), newTimestamp,
+                                                      exposureTime, orientation, file.size(),
+                                                      size, mediaType);
+        m_mediaTable->setContentHash(newId, contentHash);
+        m_mediaTable->setPlaceholderColor(newId, m_mediaTable->getPlaceholderColor(id));
+        return newId;
+    }
+
+    m_mediaTable->updateMedia(id, file.absoluteFilePath(), newTimestamp, exposureTime,
+                              orientation, file.size());
+    if (m_thumbnailCache && mediaType == MediaSource::Photo)
+        m_thumbnailCache->move(media.value(id), timestamp, file);
+
+    return id;
+}
+
 /*!
  * \brief MediaObjectFactory::addMedia creates a media object, and adds it to the
  * internal set. This is used for mediaFromDB().
@@ -350,18 +612,18 @@ bool MediaObjectFactoryWorker::readVideoMetadata(const QFileInfo &file)
  * \param exposureTime
  * \param originalOrientation
  * \param filesize
+ * \param placeholderColor
  * \return
  */
 void MediaObjectFactoryWorker::addMedia(qint64 mediaId, const QString &filename,
                                   const QSize &size, const QDateTime &timestamp,
                                   const QDateTime &exposureTime,
-                                  Orientation originalOrientation, qint64 filesize)
+                                  Orientation originalOrientation, qint64 filesize,
+                                  const QColor &placeholderColor)
 {
-    Q_UNUSED(filesize);
-
     QFileInfo file(filename);
     if (!file.exists()) {
-        m_mediaTable->remove(mediaId);
+        m_missingMedia.insert(mediaId);
         return;
     }
 
@@ -379,11 +641,28 @@ void MediaObjectFactoryWorker::addMedia(qint64 mediaId, const QString &filename,
     }
     media->setMediaTable(m_mediaTable);
 
-    media->setSize(size);
-    media->setFileTimestamp(timestamp);
-    media->setExposureDateTime(exposureTime);
-    if (mediaType == MediaSource::Photo) {
-        photo->setOriginalOrientation(originalOrientation);
+    if (fileChanged(file, mediaType, timestamp, filesize)) {
+        // Only files whose fingerprint changed get their metadata read again
+        if (!refreshMetadata(mediaId, media)) {
+            delete media;
+            return;
+        }
+
+        media->setSize(m_size);
+        media->setFileTimestamp(m_timeStamp);
+        media->setExposureDateTime(m_exposureTime);
+        media->setPlaceholderColor(m_placeholderColor);
+        if (mediaType == MediaSource::Photo) {
+            photo->setOriginalOrientation(m_orientation);
+        }
+    } else {
+        media->setSize(size);
+        media->setFileTimestamp(timestamp);
+        media->setExposureDateTime(exposureTime);
+        media->setPlaceholderColor(placeholderColor);
+        if (mediaType == MediaSource::Photo) {
+            photo->setOriginalOrientation(originalOrientation);
+        }
     }
     media->setId(mediaId);
 
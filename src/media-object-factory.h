@@ -24,14 +24,18 @@
 #include "resource.h"
 #include <orientation.h>
 
+#include <QByteArray>
+#include <QColor>
 #include <QDateTime>
 #include <QFileInfo>
 #include <QObject>
+#include <QSet>
 #include <QSize>
 #include <QThread>
 
 class MediaTable;
 class MediaObjectFactoryWorker;
+class ThumbnailCache;
 
 /*!
  * \brief The MediaObjectFactory creates phot and video objects
@@ -45,10 +49,12 @@ public:
     virtual ~MediaObjectFactory();
 
     void setMediaTable(MediaTable *mediaTable);
+    void setThumbnailCache(ThumbnailCache *thumbnailCache);
     void enableContentLoadFilter(MediaSource::MediaType filterType);
     void clear();
     void create(const QFileInfo& file, int priority, bool desktopMode, Resource *res);
     void loadMediaFromDB();
+    void removeMissingMedia();
 
 signals:
     void mediaObjectCreated(MediaSource *newMediaObject);
@@ -56,6 +62,7 @@ signals:
 
 private:    
     void enqueuePath(const QString& path, int priority);
+    void startRunCreate();
 
     MediaObjectFactoryWorker* m_worker;
     QThread m_workerThread;
@@ -77,10 +84,12 @@ public:
 public slots:
     void runCreate();
     void setMediaTable(MediaTable *mediaTable);
+    void setThumbnailCache(ThumbnailCache *thumbnailCache);
     void enableContentLoadFilter(MediaSource::MediaType filterType);
     void clear();
     void create(const QString& path);
     void mediaFromDB();
+    void removeMissingMedia();
 
 signals:
     void mediaObjectCreated(MediaSource *newMediaObject);
@@ -89,22 +98,36 @@ signals:
 private slots:
     void addMedia(qint64 mediaId, const QString& filename, const QSize& size,
                   const QDateTime& timestamp, const QDateTime& exposureTime,
-                  Orientation originalOrientation, qint64 filesize);
+                  Orientation originalOrientation, qint64 filesize,
+                  const QColor& placeholderColor);
 
 private:
     void clearMetadata();
     bool readPhotoMetadata(const QFileInfo &file);
+    void readPlaceholderColor(const QByteArray &thumbnail);
     bool readVideoMetadata(const QFileInfo &file);
+    bool fileChanged(const QFileInfo &file, MediaSource::MediaType mediaType,
+                     const QDateTime &timestamp, qint64 filesize) const;
+    bool refreshMetadata(qint64 mediaId, MediaSource *media);
+    static QByteArray contentHash(const QFileInfo &file);
+    qint64 reuseMedia(const QFileInfo &file, MediaSource::MediaType mediaType,
+                      const QByteArray &contentHash);
 
     MediaTable *m_mediaTable;
+    ThumbnailCache *m_thumbnailCache;
     MediaSource::MediaType m_filterType;
     QDateTime m_timeStamp;
     QDateTime m_exposureTime;
     Orientation m_orientation;
     qint64 m_fileSize;
     QSize m_size;
+    QColor m_placeholderColor;
 
     QSet<DataObject*> m_mediaFromDB;
+    // Media whose file was missing when loaded from the DB. Their rows are
+    // kept until the file system is checked, as the files might show up
+    // under another path.
+    QSet<qint64> m_missingMedia;
 
     friend class tst_MediaObjectFactory;
 };
@@ -38,6 +38,8 @@ MediaCollection::MediaCollection(MediaTable *mediaTable)
 {
     // By default, sort all media by its exposure date time, descending
     setComparator(exposureDateTimeDescendingComparator);
+
+    publishPathIndex();
 }
 
 /*!
@@ -103,7 +105,7 @@ void MediaCollection::notifyContentsChanged(const QSet<DataObject*>* added,
 
             MediaSource* media = qobject_cast<MediaSource*>(o);
             if (media != 0) {
-                m_fileMediaMap.insert(media->file().absoluteFilePath(), media);
+                m_pathIndex.insert(media->file().absoluteFilePath(), media->id());
                 QObject::connect(media, SIGNAL(busyChanged(bool)),
                                  this, SIGNAL(mediaIsBusy(bool)));
             }
@@ -117,7 +119,7 @@ void MediaCollection::notifyContentsChanged(const QSet<DataObject*>* added,
             MediaSource* media = qobject_cast<MediaSource*>(o);
 
             if (media != 0) {
-                m_fileMediaMap.remove(media->file().absoluteFilePath());
+                m_pathIndex.remove(media->file().absoluteFilePath());
                 QObject::disconnect(media, SIGNAL(busyChanged(bool)),
                                     this, SIGNAL(mediaIsBusy(bool)));
             }
@@ -131,31 +133,47 @@ void MediaCollection::notifyContentsChanged(const QSet<DataObject*>* added,
         }
     }
 
-    if (added || removed)
+    if (added || removed) {
+        publishPathIndex();
         emit collectionChanged();
+    }
 }
 
 /*!
- * \brief MediaCollection::photoFromFileinfo
- * Returns an existing photo object if we've already loaded one
- * for this file, or NULL otherwise. Used for preventing duplicates
- * from appearing after an edit.
- * \param file_to_load
+ * \brief MediaCollection::idForFile
+ * Returns the ID of the media loaded for this file, or INVALID_ID otherwise.
+ * Can be called from any thread.
+ * \param filename absolute path of the file
  * \return
  */
-const MediaSource *MediaCollection::mediaFromFileinfo(const QFileInfo& file) const
+qint64 MediaCollection::idForFile(const QString& filename) const
 {
-    return m_fileMediaMap.value(file.absoluteFilePath(), 0);
+    std::shared_ptr<const PathIndex> index = std::atomic_load(&m_pathIndexSnapshot);
+    return index->value(filename, INVALID_ID);
 }
 
 /*!
  * \brief MediaCollection::containsFile
- * \param filename
+ * Can be called from any thread.
+ * \param filename absolute path of the file
  * \return
  */
 bool MediaCollection::containsFile(const QString &filename) const
 {
-    return m_fileMediaMap.contains(filename);
+    std::shared_ptr<const PathIndex> index = std::atomic_load(&m_pathIndexSnapshot);
+    return index->contains(filename);
+}
+
+/*!
+ * \brief MediaCollection::publishPathIndex makes the current path index
+ * visible to other threads. Copying the QHash is cheap because it is
+ * implicitly shared; the next change to m_pathIndex detaches it, so readers
+ * keep the old snapshot until they load the new one.
+ */
+void MediaCollection::publishPathIndex()
+{
+    std::shared_ptr<const PathIndex> index = std::make_shared<const PathIndex>(m_pathIndex);
+    std::atomic_store(&m_pathIndexSnapshot, index);
 }
 
 /*!
@@ -214,3 +232,22 @@ void MediaCollection::destroy(qint64 id, bool destroy_backing)
         SourceCollection::destroy(media, destroy_backing, true);
     }
 }
+
+/*!
+ * \brief MediaCollection::move updates a media whose file got renamed or moved.
+ * The media, its DB row and album membership are kept, only the path changes.
+ * \param id
+ * \param newFile
+ */
+void MediaCollection::move(qint64 id, const QFileInfo &newFile)
+{
+    MediaSource *media = mediaForId(id);
+    if (media == 0)
+        return;
+
+    m_pathIndex.remove(media->file().absoluteFilePath());
+    m_mediaTable->setFilename(id, newFile.absoluteFilePath());
+    media->setFile(newFile);
+    m_pathIndex.insert(newFile.absoluteFilePath(), id);
+    publishPathIndex();
+}
@@ -24,6 +24,8 @@
 #include <QHash>
 #include <QSet>
 
+#include <memory>
+
 // core
 #include "source-collection.h"
 
@@ -45,7 +47,7 @@ public:
     static bool exposureDateTimeDescendingComparator(DataObject* a, DataObject* b);
 
     MediaSource* mediaForId(qint64 id);
-    const MediaSource* mediaFromFileinfo(const QFileInfo &file) const;
+    qint64 idForFile(const QString& filename) const;
     bool containsFile(const QString& filename) const;
 
     virtual void add(DataObject* object);
@@ -54,6 +56,8 @@ public:
     void destroy(MediaSource *media, bool destroy_backing);
     void destroy(qint64 id, bool destroy_backing);
 
+    void move(qint64 id, const QFileInfo& newFile);
+
 signals:
     void mediaIsBusy(bool busy);
     void collectionChanged();
@@ -64,9 +68,17 @@ protected slots:
                                        bool notify);
 
 private:
-    // Used by photoFromFileinfo() to prevent ourselves from accidentally
-    // seeing a duplicate photo after an edit.
-    QHash<QString, MediaSource*> m_fileMediaMap;
+    typedef QHash<QString, qint64> PathIndex;
+
+    void publishPathIndex();
+
+    // Absolute file path -> media ID, only used from the thread owning the
+    // collection
+    PathIndex m_pathIndex;
+    // Immutable copy of m_pathIndex, replaced as a whole after each change.
+    // Other threads (like the media monitor) read it through
+    // std::atomic_load(), so they never see a half updated index.
+    std::shared_ptr<const PathIndex> m_pathIndexSnapshot;
     QHash<qint64, DataObject*> m_idMap;
     MediaTable *m_mediaTable;
 };
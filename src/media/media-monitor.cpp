@@ -19,14 +19,21 @@
 
 #include "media-monitor.h"
 #include "media-collection.h"
-#include "media-source.h"
+
+// database
+#include "database.h"
 
 #include <QDir>
 #include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
 #include <QSet>
 #include <QString>
 
+#include <sys/stat.h>
+
+const int MediaMonitorWorker::MAX_PENDING_DIRECTORIES = 256;
+
 /*!
  * \brief MediaMonitor::MediaMonitor
  */
@@ -43,6 +50,10 @@ MediaMonitor::MediaMonitor(QObject *parent)
                      this, SIGNAL(mediaItemAdded(QString, int)), Qt::QueuedConnection);
     QObject::connect(m_worker, SIGNAL(mediaItemRemoved(qint64)),
                      this, SIGNAL(mediaItemRemoved(qint64)), Qt::QueuedConnection);
+    QObject::connect(m_worker, SIGNAL(mediaItemChanged(QString)),
+                     this, SIGNAL(mediaItemChanged(QString)), Qt::QueuedConnection);
+    QObject::connect(m_worker, SIGNAL(mediaItemMoved(qint64, QString)),
+                     this, SIGNAL(mediaItemMoved(qint64, QString)), Qt::QueuedConnection);
     QObject::connect(m_worker, SIGNAL(consistencyCheckFinished()),
                      this, SIGNAL(consistencyCheckFinished()), Qt::QueuedConnection);
 
@@ -88,7 +99,8 @@ void MediaMonitor::checkConsistency(const MediaCollection *mediaCollection)
  */
 void MediaMonitor::setMonitoringOnHold(bool onHold)
 {
-    m_worker->setMonitoringOnHold(onHold);
+    QMetaObject::invokeMethod(m_worker, "setMonitoringOnHold", Qt::QueuedConnection,
+                              Q_ARG(bool, onHold));
 }
 
 /*!
@@ -108,7 +120,9 @@ MediaMonitorWorker::MediaMonitorWorker(QObject *parent)
       m_blacklistedDirectories(),
       m_watcher(this),
       m_manifest(),
+      m_pendingOverflow(false),
       m_fileActivityTimer(this),
+      m_mediaCollection(0),
       m_onHold(false)
 {
     QObject::connect(&m_watcher, SIGNAL(directoryChanged(const QString&)), this,
@@ -137,12 +151,16 @@ void MediaMonitorWorker::setMediaCollection(const MediaCollection *mediaCollecti
 }
 
 /*!
- * \brief MediaMonitorWorker::setMonitoringOnHold
+ * \brief MediaMonitorWorker::setMonitoringOnHold while on hold, changed
+ * directories are only collected. They get scanned once the hold is released.
  * \param onHold
  */
 void MediaMonitorWorker::setMonitoringOnHold(bool onHold)
 {
     m_onHold = onHold;
+
+    if (!m_onHold && (m_pendingOverflow || !m_pendingDirectories.isEmpty()))
+        m_fileActivityTimer.start();
 }
 
 /*!
@@ -150,7 +168,10 @@ void MediaMonitorWorker::setMonitoringOnHold(bool onHold)
  */
 QStringList MediaMonitorWorker::getManifest()
 {
-    return m_manifest;
+    QStringList allFiles;
+    foreach (const QStringList &files, m_manifest)
+        allFiles += files;
+    return allFiles;
 }
 
 /*!
@@ -237,7 +258,8 @@ void MediaMonitorWorker::startMonitoring(const QStringList &targetDirectories, c
     QStringList newDirectories = findNewSubDirectories(targetDirectories, blacklistedDirectories);
     m_targetDirectories += newDirectories;
     m_blacklistedDirectories = blacklistedDirectories;
-    m_manifest = generateManifest(m_targetDirectories);
+    m_fingerprints.clear();
+    m_manifest = generateManifest(m_targetDirectories, &m_fingerprints);
     m_watcher.addPaths(newDirectories);
 }
 
@@ -252,12 +274,24 @@ void MediaMonitorWorker::checkConsistency()
 }
 
 /*!
- * \brief MediaMonitor::onDirectoryEvent
+ * \brief MediaMonitor::onDirectoryEvent remembers the changed directory, so
+ * only that one needs to be scanned again
  * \param eventSource
  */
 void MediaMonitorWorker::onDirectoryEvent(const QString& eventSource)
 {
-    m_fileActivityTimer.start();
+    if (!m_pendingOverflow) {
+        m_pendingDirectories.insert(eventSource);
+        if (m_pendingDirectories.size() > MAX_PENDING_DIRECTORIES) {
+            // Too many changes to track them one by one, rescan everything
+            m_pendingDirectories.clear();
+            m_pendingOverflow = true;
+        }
+    }
+
+    // No need to wake up while on hold, releasing it restarts the timer
+    if (!m_onHold)
+        m_fileActivityTimer.start();
 }
 
 /*!
@@ -265,53 +299,230 @@ void MediaMonitorWorker::onDirectoryEvent(const QString& eventSource)
  */
 void MediaMonitorWorker::onFileActivityCeased()
 {
-    if (m_onHold) {
-        m_fileActivityTimer.start();
+    if (m_onHold)
         return;
+
+    processPendingChanges();
+}
+
+/*!
+ * \brief MediaMonitorWorker::processPendingChanges scans the directories that
+ * changed since the last scan, and reports the differences. Files that got
+ * added and removed again in the meantime are not reported at all.
+ */
+void MediaMonitorWorker::processPendingChanges()
+{
+    QStringList dirs;
+    if (m_pendingOverflow) {
+        dirs = m_targetDirectories;
+    } else {
+        dirs = m_pendingDirectories.toList();
+
+        // A directory that got moved away or removed doesn't report that
+        // itself, only its parent does. Scan the known directories below the
+        // changed ones that are gone, so their files get reported.
+        foreach (const QString &dir, m_pendingDirectories) {
+            const QString prefix = dir + QLatin1Char('/');
+            foreach (const QString &known, m_targetDirectories) {
+                if (known.startsWith(prefix) && !QDir(known).exists())
+                    dirs.append(known);
+            }
+        }
+        dirs.removeDuplicates();
+    }
+    m_pendingDirectories.clear();
+    m_pendingOverflow = false;
+
+    // Stop watching the directories that are gone, so they are picked up
+    // again if they get re-created
+    QStringList removedDirectories;
+    foreach (const QString &dir, dirs) {
+        if (!QDir(dir).exists())
+            removedDirectories.append(dir);
+    }
+    if (!removedDirectories.isEmpty()) {
+        foreach (const QString &dir, removedDirectories)
+            m_targetDirectories.removeAll(dir);
+        m_watcher.removePaths(removedDirectories);
     }
 
-    QStringList currentDirectories = QStringList(m_targetDirectories);
-    QStringList newDirectories = findNewSubDirectories(currentDirectories, m_blacklistedDirectories);
+    QStringList newDirectories = findNewSubDirectories(dirs, m_blacklistedDirectories);
 
     m_targetDirectories += newDirectories;
-    m_watcher.addPaths(newDirectories);
+    if (!newDirectories.isEmpty())
+        m_watcher.addPaths(newDirectories);
+
+    dirs += newDirectories;
+    dirs.removeDuplicates();
+
+    QHash<QString, FileFingerprint> new_fingerprints;
+    Manifest new_manifest = generateManifest(dirs, &new_fingerprints);
+
+    QStringList old_files;
+    QStringList new_files;
+    foreach (const QString &dir, dirs) {
+        old_files += m_manifest.value(dir);
+        new_files += new_manifest.value(dir);
+    }
 
-    QStringList new_manifest = generateManifest(m_targetDirectories);
+    QStringList added = subtractManifest(new_files, old_files);
+    QStringList removed = subtractManifest(old_files, new_files);
+
+    // Renamed and moved files are reported as such, and not as removed + added
+    findMovedFiles(&added, &removed, new_fingerprints);
 
-    QStringList added = subtractManifest(new_manifest, m_manifest);
     for (int i = 0; i < added.size(); i++)
         emit mediaItemAdded(added.at(i), Qt::HighEventPriority);
 
-    QStringList removed = subtractManifest(m_manifest, new_manifest);
     for (int i = 0; i < removed.size(); i++) {
-        QFileInfo file(removed.at(i));
-        const MediaSource *media = m_mediaCollection->mediaFromFileinfo(file);
-        if (media)
-            emit mediaItemRemoved(media->id());
+        qint64 mediaId = m_mediaCollection->idForFile(removed.at(i));
+        if (mediaId != INVALID_ID)
+            emit mediaItemRemoved(mediaId);
+    }
+
+    // Files that are still there, but got rewritten in the meantime
+    QHash<QString, FileFingerprint>::const_iterator it;
+    for (it = new_fingerprints.constBegin(); it != new_fingerprints.constEnd(); ++it) {
+        QHash<QString, FileFingerprint>::const_iterator old = m_fingerprints.constFind(it.key());
+        if (old == m_fingerprints.constEnd())
+            continue;
+
+        if (old->size != it->size || old->lastModified != it->lastModified)
+            emit mediaItemChanged(it.key());
+    }
+
+    // Replace the scanned part of the manifest
+    foreach (const QString &dir, dirs) {
+        foreach (const QString &file, m_manifest.value(dir))
+            m_fingerprints.remove(file);
+        m_manifest.remove(dir);
     }
 
-    m_manifest = new_manifest;
+    Manifest::const_iterator dir;
+    for (dir = new_manifest.constBegin(); dir != new_manifest.constEnd(); ++dir)
+        m_manifest.insert(dir.key(), dir.value());
+
+    for (it = new_fingerprints.constBegin(); it != new_fingerprints.constEnd(); ++it)
+        m_fingerprints.insert(it.key(), it.value());
 }
 
 /*!
  * \brief MediaMonitor::generateManifest
  * \param dir
+ * \param fingerprints if not null, gets filled with the fingerprint of every
+ * file in the manifest
  * \return
  */
-QStringList MediaMonitorWorker::generateManifest(const QStringList &dirs)
+MediaMonitorWorker::Manifest MediaMonitorWorker::generateManifest(const QStringList &dirs,
+                                                                  QHash<QString, FileFingerprint> *fingerprints)
 {
-    QStringList allFiles;
+    Manifest allFiles;
     foreach (const QString &dirName, dirs) {
         QDir dir(dirName);
-        QStringList fileList = dir.entryList(QDir::Files, QDir::Time);
-        foreach (const QString &fileName, fileList) {
-            const QFileInfo fi(dirName + QDir::separator() + fileName);
-            allFiles.append(fi.absoluteFilePath());
+        QFileInfoList fileList = dir.entryInfoList(QDir::Files, QDir::Time);
+        if (fileList.isEmpty())
+            continue;
+
+        QStringList &files = allFiles[dirName];
+        foreach (const QFileInfo &fi, fileList) {
+            const QString path = fi.absoluteFilePath();
+            files.append(path);
+
+            FileFingerprint fingerprint;
+            if (fingerprints && readFingerprint(path, &fingerprint))
+                fingerprints->insert(path, fingerprint);
         }
     }
     return allFiles;
 }
 
+/*!
+ * \brief MediaMonitorWorker::readFingerprint
+ * \param path
+ * \param fingerprint
+ * \return false if the file could not be stat'ed
+ */
+bool MediaMonitorWorker::readFingerprint(const QString &path, FileFingerprint *fingerprint)
+{
+    // QFileInfo does not expose the device and inode numbers
+    struct stat buf;
+    if (::stat(QFile::encodeName(path).constData(), &buf) != 0)
+        return false;
+
+    fingerprint->device = buf.st_dev;
+    fingerprint->inode = buf.st_ino;
+    fingerprint->size = buf.st_size;
+    fingerprint->lastModified = qint64(buf.st_mtim.tv_sec) * 1000 +
+            buf.st_mtim.tv_nsec / 1000000;
+    return true;
+}
+
+/*!
+ * \brief MediaMonitorWorker::isSameFile
+ * \param f1
+ * \param f2
+ * \return true if both fingerprints belong to the same, unmodified file
+ */
+bool MediaMonitorWorker::isSameFile(const FileFingerprint &f1, const FileFingerprint &f2)
+{
+    return f1.device == f2.device && f1.inode == f2.inode &&
+            f1.size == f2.size && f1.lastModified == f2.lastModified;
+}
+
+/*!
+ * \brief MediaMonitorWorker::findMovedFiles pairs removed and added files
+ * that are the same file on disk (same device, inode, size and modification
+ * time). Those are reported as moved, and get taken out of both lists.
+ * \param added
+ * \param removed
+ * \param newFingerprints
+ */
+void MediaMonitorWorker::findMovedFiles(QStringList *added, QStringList *removed,
+                                        const QHash<QString, FileFingerprint> &newFingerprints)
+{
+    if (added->isEmpty() || removed->isEmpty() || !m_mediaCollection)
+        return;
+
+    // Index the removed files by inode, which is unique per device
+    QMultiHash<quint64, QString> removedByInode;
+    foreach (const QString &path, *removed) {
+        QHash<QString, FileFingerprint>::const_iterator fp = m_fingerprints.constFind(path);
+        if (fp != m_fingerprints.constEnd())
+            removedByInode.insert(fp->inode, path);
+    }
+
+    QStringList::iterator it = added->begin();
+    while (it != added->end()) {
+        QHash<QString, FileFingerprint>::const_iterator newFp = newFingerprints.constFind(*it);
+        if (newFp == newFingerprints.constEnd()) {
+            ++it;
+            continue;
+        }
+
+        QString oldPath;
+        QMultiHash<quint64, QString>::iterator candidate = removedByInode.find(newFp->inode);
+        while (candidate != removedByInode.end() && candidate.key() == newFp->inode) {
+            if (isSameFile(m_fingerprints.value(candidate.value()), *newFp)) {
+                oldPath = candidate.value();
+                removedByInode.erase(candidate);
+                break;
+            }
+            ++candidate;
+        }
+
+        qint64 mediaId = oldPath.isEmpty() ? INVALID_ID :
+                m_mediaCollection->idForFile(oldPath);
+        if (mediaId == INVALID_ID) {
+            ++it;
+            continue;
+        }
+
+        emit mediaItemMoved(mediaId, *it);
+        removed->removeOne(oldPath);
+        it = added->erase(it);
+    }
+}
+
 /*!
  * \brief MediaMonitor::subtractManifest
  * \param m1
@@ -333,8 +544,10 @@ QStringList MediaMonitorWorker::subtractManifest(const QStringList& m1,
  */
 void MediaMonitorWorker::checkForNewMedias()
 {
-    foreach (const QString& file, m_manifest) {
-        if (!m_mediaCollection->containsFile(file))
-            emit mediaItemAdded(file, Qt::NormalEventPriority);
+    foreach (const QStringList& files, m_manifest) {
+        foreach (const QString& file, files) {
+            if (!m_mediaCollection->containsFile(file))
+                emit mediaItemAdded(file, Qt::NormalEventPriority);
+        }
     }
 }
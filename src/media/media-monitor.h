@@ -21,7 +21,9 @@
 #define GALLERY_MEDIA_MONITOR_H_
 
 #include <QFileSystemWatcher>
+#include <QHash>
 #include <QObject>
+#include <QSet>
 #include <QStringList>
 #include <QThread>
 #include <QTimer>
@@ -52,6 +54,8 @@ public slots:
 signals:
     void mediaItemAdded(QString newItem, int priority);
     void mediaItemRemoved(qint64 mediaId);
+    void mediaItemChanged(QString item);
+    void mediaItemMoved(qint64 mediaId, QString newItem);
     void consistencyCheckFinished();
 
 private:
@@ -73,10 +77,10 @@ public:
     virtual ~MediaMonitorWorker();
 
     void setMediaCollection(const MediaCollection *mediaCollection);
-    void setMonitoringOnHold(bool onHold);
     QStringList getManifest();
 
 public slots:
+    void setMonitoringOnHold(bool onHold);
     void startMonitoring(const QStringList& targetDirectories, const QStringList &blacklistedDirectories);
     QStringList findNewSubDirectories(const QStringList& currentDirectories, const QStringList& blacklistedDirectories);
     QStringList expandSubDirectories(const QString& dirPath);
@@ -85,6 +89,8 @@ public slots:
 signals:
     void mediaItemAdded(QString newItem, int priority);
     void mediaItemRemoved(qint64 mediaId);
+    void mediaItemChanged(QString item);
+    void mediaItemMoved(qint64 mediaId, QString newItem);
     void consistencyCheckFinished();
 
 private slots:
@@ -92,14 +98,42 @@ private slots:
     void onFileActivityCeased();
 
 private:
-    QStringList generateManifest(const QStringList& dirs);
+    // Maximum number of changed directories remembered between two scans.
+    // When more change, everything gets scanned again.
+    static const int MAX_PENDING_DIRECTORIES;
+
+    // directory -> files in that directory
+    typedef QHash<QString, QStringList> Manifest;
+
+    /*!
+     * \brief The FileFingerprint struct is used to detect files that got
+     * rewritten or moved in between two scans
+     */
+    struct FileFingerprint {
+        quint64 device;
+        quint64 inode;
+        qint64 size;
+        qint64 lastModified;
+    };
+
+    static bool readFingerprint(const QString& path, FileFingerprint *fingerprint);
+    static bool isSameFile(const FileFingerprint& f1, const FileFingerprint& f2);
+
+    void processPendingChanges();
+    Manifest generateManifest(const QStringList& dirs,
+                              QHash<QString, FileFingerprint> *fingerprints = 0);
+    void findMovedFiles(QStringList *added, QStringList *removed,
+                        const QHash<QString, FileFingerprint>& newFingerprints);
     QStringList subtractManifest(const QStringList& m1, const QStringList& m2);
     void checkForNewMedias();
 
     QStringList m_targetDirectories;
     QStringList m_blacklistedDirectories;
     QFileSystemWatcher m_watcher;
-    QStringList m_manifest;
+    Manifest m_manifest;
+    QHash<QString, FileFingerprint> m_fingerprints;
+    QSet<QString> m_pendingDirectories;
+    bool m_pendingOverflow;
     QTimer m_fileActivityTimer;
     const MediaCollection *m_mediaCollection;
     bool m_onHold;
@@ -67,6 +67,21 @@ QFileInfo MediaSource::file() const
     return m_file;
 }
 
+/*!
+ * \brief MediaSource::setFile changes the file backing this media, used when
+ * the file got renamed or moved
+ * \param file
+ */
+void MediaSource::setFile(const QFileInfo& file)
+{
+    if (m_file == file)
+        return;
+
+    m_file = file;
+    emit pathChanged();
+    notifyDataChanged();
+}
+
 /*!
  * \brief MediaSource::path
  * \return
@@ -149,6 +164,29 @@ void MediaSource::setFileTimestamp(const QDateTime& timestamp)
     m_fileTimestamp = timestamp;
 }
 
+/*!
+ * \brief MediaSource::placeholderColor
+ * \return the average color of the media, to show until its thumbnail is
+ * loaded. Invalid if it's not known.
+ */
+const QColor& MediaSource::placeholderColor() const
+{
+    return m_placeholderColor;
+}
+
+/*!
+ * \brief MediaSource::setPlaceholderColor
+ * \param color
+ */
+void MediaSource::setPlaceholderColor(const QColor& color)
+{
+    if (m_placeholderColor == color)
+        return;
+
+    m_placeholderColor = color;
+    emit placeholderColorChanged();
+}
+
 /*!
  * \brief MediaSource::size
  * \return
@@ -232,6 +270,15 @@ void MediaSource::setMediaTable(MediaTable *mediaTable)
     m_mediaTable = mediaTable;
 }
 
+/*!
+ * \brief MediaSource::mediaTable
+ * \return the table the media is stored in, or 0 if it isn't set
+ */
+MediaTable *MediaSource::mediaTable() const
+{
+    return m_mediaTable;
+}
+
 /*!
  * \brief MediaSource::set_id
  * \param id
@@ -257,6 +304,7 @@ qint64 MediaSource::id() const
 void MediaSource::refresh()
 {
     m_file.refresh();
+    notifyDataChanged();
 }
 
 /*!
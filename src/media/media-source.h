@@ -26,6 +26,7 @@
 // util
 #include "orientation.h"
 
+#include <QColor>
 #include <QDate>
 #include <QDateTime>
 #include <QFileInfo>
@@ -55,6 +56,7 @@ class MediaSource : public DataSource
     Q_PROPERTY(bool busy READ busy NOTIFY busyChanged)
     Q_PROPERTY(int width READ width NOTIFY sizeChanged)
     Q_PROPERTY(int height READ height NOTIFY sizeChanged)
+    Q_PROPERTY(QColor placeholderColor READ placeholderColor NOTIFY placeholderColorChanged)
     Q_ENUMS(MediaType)
 
 signals:
@@ -64,6 +66,7 @@ signals:
     void exposureDateTimeChanged();
     void dataChanged();
     void sizeChanged();
+    void placeholderColorChanged();
     void busyChanged(bool);
 
 public:
@@ -79,6 +82,7 @@ public:
     virtual MediaType type() const;
 
     QFileInfo file() const;
+    void setFile(const QFileInfo& file);
     QUrl path() const;
     qint64 lastModified() const;
 
@@ -96,6 +100,9 @@ public:
 
     const QSize& size();
 
+    const QColor& placeholderColor() const;
+    void setPlaceholderColor(const QColor& color);
+
     qint64 id() const;
     void setId(qint64 id);
 
@@ -110,6 +117,7 @@ public Q_SLOTS:
 
 protected:
     bool isSizeSet() const;
+    MediaTable *mediaTable() const;
 
     virtual void destroySource(bool deleteBacking, bool asOrphan);
 
@@ -132,6 +140,7 @@ private:
     QSize m_size;
     QDateTime m_exposureDateTime;
     QDateTime m_fileTimestamp;
+    QColor m_placeholderColor;
     bool m_busy;
     MediaTable *m_mediaTable;
 };
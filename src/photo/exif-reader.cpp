@@ -0,0 +1,577 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "exif-reader.h"
+#include "photo-metadata.h"
+
+#include <QFile>
+#include <QList>
+
+#include <cstring>
+#include <limits>
+
+#include <unistd.h>
+
+const int ExifReader::MAX_HEADER_SIZE = 64 * 1024;
+const int ExifReader::MAX_IFD_COUNT = 32;
+
+namespace {
+// JPEG markers
+const uchar MARKER_START = 0xFF;
+const uchar MARKER_SOF2 = 0xC2;
+const uchar MARKER_SOI = 0xD8;
+const uchar MARKER_EOI = 0xD9;
+const uchar MARKER_SOS = 0xDA;
+const uchar MARKER_APP1 = 0xE1;
+
+// TIFF tags
+const quint16 TAG_COMPRESSION = 0x0103;
+const quint16 TAG_STRIP_OFFSETS = 0x0111;
+const quint16 TAG_ORIENTATION = 0x0112;
+const quint16 TAG_STRIP_BYTE_COUNTS = 0x0117;
+const quint16 TAG_SUB_IFDS = 0x014A;
+const quint16 TAG_JPEG_INTERCHANGE_FORMAT = 0x0201;
+const quint16 TAG_JPEG_INTERCHANGE_FORMAT_LENGTH = 0x0202;
+const quint16 TAG_EXIF_IFD = 0x8769;
+const quint16 TAG_DATETIME_ORIGINAL = 0x9003;
+const quint16 TAG_DATETIME_DIGITIZED = 0x9004;
+const quint16 TAG_PIXEL_X_DIMENSION = 0xA002;
+const quint16 TAG_PIXEL_Y_DIMENSION = 0xA003;
+
+// TIFF types
+const quint16 TYPE_ASCII = 2;
+const quint16 TYPE_SHORT = 3;
+const quint16 TYPE_LONG = 4;
+const quint16 TYPE_IFD = 13;
+
+// TIFF compressions
+const quint32 COMPRESSION_OLD_JPEG = 6;
+const quint32 COMPRESSION_JPEG = 7;
+
+// Extensions of the camera RAW files with a TIFF structure
+const char* RAW_EXTENSIONS[] = { "arw", "cr2", "dng", "nef", "nrw", "pef", "srw" };
+
+const quint32 IFD_ENTRY_SIZE = 12;
+
+// markers without a length, that don't start a segment
+bool is_standalone_marker(uchar marker) {
+    return marker == 0x01 || (marker >= 0xD0 && marker <= MARKER_SOI);
+}
+
+// all start of frame markers, except DHT, JPG and DAC which share the range
+bool is_sof_marker(uchar marker) {
+    return marker >= 0xC0 && marker <= 0xCF &&
+            marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+quint16 read_big_endian_short(const uchar* data) {
+    return (data[0] << 8) | data[1];
+}
+
+// the size of a JPEG image Qt can decode, so not of the lossless JPEG
+// images RAW files keep the sensor data in
+bool jpeg_frame_size(const uchar* data, quint32 length, QSize* size) {
+    if (length < 4 || data[0] != MARKER_START || data[1] != MARKER_SOI)
+        return false;
+
+    quint32 pos = 2;
+    while (pos + 4 <= length) {
+        if (data[pos] != MARKER_START)
+            return false;
+
+        uchar marker = data[pos + 1];
+        if (marker == MARKER_START) {
+            // fill byte
+            pos++;
+            continue;
+        }
+        if (is_standalone_marker(marker)) {
+            pos += 2;
+            continue;
+        }
+        if (marker == MARKER_SOS || marker == MARKER_EOI)
+            return false;
+
+        if (is_sof_marker(marker)) {
+            if (marker > MARKER_SOF2 || pos + 9 > length)
+                return false;
+            *size = QSize(read_big_endian_short(data + pos + 7),
+                          read_big_endian_short(data + pos + 5));
+            return !size->isEmpty();
+        }
+
+        quint32 segmentLength = read_big_endian_short(data + pos + 2);
+        if (segmentLength < 2)
+            return false;
+        pos += 2 + segmentLength;
+    }
+
+    return false;
+}
+} // namespace
+
+/*!
+ * \brief ExifReader::ExifReader
+ * \param filename
+ */
+ExifReader::ExifReader(const QString& filename)
+    : m_filename(filename),
+      m_tiff(0),
+      m_tiffLength(0),
+      m_tiffOffset(0),
+      m_bigEndian(false),
+      m_readPreviews(false),
+      m_ifdCount(0),
+      m_orientation(TOP_LEFT_ORIGIN),
+      m_orientationOffset(-1),
+      m_previewOffset(0),
+      m_previewLength(0)
+{
+}
+
+/*!
+ * \brief ExifReader::isRawFile
+ * \param file
+ * \return true if the file is a camera RAW file that can be read with readRaw()
+ */
+bool ExifReader::isRawFile(const QFileInfo& file)
+{
+    QString extension = file.suffix().toLower();
+    for (size_t i = 0; i < sizeof(RAW_EXTENSIONS) / sizeof(RAW_EXTENSIONS[0]); i++) {
+        if (extension == QLatin1String(RAW_EXTENSIONS[i]))
+            return true;
+    }
+
+    return false;
+}
+
+/*!
+ * \brief ExifReader::read reads the tags from the start of the file
+ * \return false if the file is not a JPEG file, or not a valid one
+ */
+bool ExifReader::read()
+{
+    QFile file(m_filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    return parseJpeg(file.read(MAX_HEADER_SIZE));
+}
+
+/*!
+ * \brief ExifReader::readRaw reads the tags of a camera RAW file, and finds
+ * the biggest JPEG preview in it. The IFDs and previews can be anywhere in
+ * the file, so it gets mapped instead of read.
+ * \return false if the file is not a TIFF file, or has no JPEG preview
+ */
+bool ExifReader::readRaw()
+{
+    QFile file(m_filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 length = qMin(file.size(), qint64(std::numeric_limits<int>::max()));
+    uchar* data = file.map(0, length);
+    if (data == 0)
+        return false;
+
+    m_readPreviews = true;
+    m_tiffOffset = 0;
+    parseTiff(data, length);
+    m_readPreviews = false;
+    file.unmap(data);
+
+    return m_previewLength > 0;
+}
+
+/*!
+ * \brief ExifReader::exposureTime
+ * \return the time the photo was digitized, or taken. Same order as used by
+ * PhotoMetadata::exposureTime()
+ */
+QDateTime ExifReader::exposureTime() const
+{
+    if (m_dateTimeDigitized.isValid())
+        return m_dateTimeDigitized;
+
+    return m_dateTimeOriginal;
+}
+
+/*!
+ * \brief ExifReader::orientation
+ * \return
+ */
+Orientation ExifReader::orientation() const
+{
+    return m_orientation;
+}
+
+/*!
+ * \brief ExifReader::size
+ * \return the size of the stored image, or of the preview of a RAW file, not
+ * rotated by its orientation
+ */
+QSize ExifReader::size() const
+{
+    if (m_size.isValid())
+        return m_size;
+
+    return m_exifSize;
+}
+
+/*!
+ * \brief ExifReader::preview
+ * \return the JPEG preview found by readRaw(), empty if there is none
+ */
+QByteArray ExifReader::preview() const
+{
+    if (m_previewLength == 0)
+        return QByteArray();
+
+    QFile file(m_filename);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(m_previewOffset))
+        return QByteArray();
+
+    return file.read(m_previewLength);
+}
+
+/*!
+ * \brief ExifReader::thumbnail
+ * \return the small JPEG thumbnail in the Exif data of a JPEG file, as found
+ * by read(). Empty if there is none.
+ */
+QByteArray ExifReader::thumbnail() const
+{
+    return m_thumbnail;
+}
+
+/*!
+ * \brief ExifReader::writeOrientation overwrites the value of the Orientation
+ * tag found by read() or readRaw(). That's a write of two bytes, instead of
+ * the whole file Exiv2 may write.
+ * \param orientation
+ * \return false if the file has no Orientation tag, or can't be written
+ */
+bool ExifReader::writeOrientation(Orientation orientation) const
+{
+    if (m_orientationOffset < 0)
+        return false;
+
+    QFile file(m_filename);
+    if (!file.open(QIODevice::ReadWrite))
+        return false;
+
+    uchar value[2];
+    if (m_bigEndian) {
+        value[0] = 0;
+        value[1] = orientation;
+    } else {
+        value[0] = orientation;
+        value[1] = 0;
+    }
+
+    return ::pwrite(file.handle(), value, sizeof(value), m_orientationOffset) == ssize_t(sizeof(value));
+}
+
+/*!
+ * \brief ExifReader::parseJpeg goes through the segments before the image
+ * data, for the Exif data and the frame size
+ * \param data
+ * \return
+ */
+bool ExifReader::parseJpeg(const QByteArray& data)
+{
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    int length = data.size();
+    if (length < 4 || bytes[0] != MARKER_START || bytes[1] != MARKER_SOI)
+        return false;
+
+    int pos = 2;
+    while (pos + 4 <= length) {
+        if (bytes[pos] != MARKER_START)
+            return false;
+
+        uchar marker = bytes[pos + 1];
+        if (marker == MARKER_START) {
+            // fill byte
+            pos++;
+            continue;
+        }
+        if (is_standalone_marker(marker)) {
+            pos += 2;
+            continue;
+        }
+        if (marker == MARKER_SOS || marker == MARKER_EOI)
+            break;
+
+        int segmentLength = read_big_endian_short(bytes + pos + 2);
+        if (segmentLength < 2)
+            return false;
+
+        const uchar* segment = bytes + pos + 4;
+        int available = qMin(segmentLength - 2, length - pos - 4);
+        if (marker == MARKER_APP1 && available > 6 && memcmp(segment, "Exif\0\0", 6) == 0) {
+            m_tiffOffset = pos + 4 + 6;
+            parseTiff(segment + 6, available - 6);
+        } else if (is_sof_marker(marker) && available >= 5) {
+            m_size = QSize(read_big_endian_short(segment + 3), read_big_endian_short(segment + 1));
+        }
+
+        pos += 2 + segmentLength;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief ExifReader::parseTiff parses the TIFF structure of the Exif data
+ * \param tiff
+ * \param length
+ */
+void ExifReader::parseTiff(const uchar* tiff, int length)
+{
+    if (length < 8)
+        return;
+
+    if (tiff[0] == 'I' && tiff[1] == 'I')
+        m_bigEndian = false;
+    else if (tiff[0] == 'M' && tiff[1] == 'M')
+        m_bigEndian = true;
+    else
+        return;
+
+    m_tiff = tiff;
+    m_tiffLength = length;
+
+    m_ifdCount = 0;
+    if (readShort(2) == 42)
+        parseIfd(readLong(4), PrimaryIfd);
+
+    m_tiff = 0;
+    m_tiffLength = 0;
+}
+
+/*!
+ * \brief ExifReader::parseIfd reads the tags of IFD0 or of the Exif IFD.
+ * When reading a JPEG file, it follows IFD0 to IFD1 for the Exif thumbnail.
+ * When reading a RAW file, it also follows the chain of IFDs and their
+ * SubIFDs to the JPEG previews.
+ * \param offset
+ * \param type
+ */
+void ExifReader::parseIfd(quint32 offset, IfdType type)
+{
+    if (offset < 8 || offset > m_tiffLength - 2 || ++m_ifdCount > MAX_IFD_COUNT)
+        return;
+
+    quint32 exifOffset = 0;
+    quint32 compression = 0;
+    quint32 stripOffset = 0;
+    quint32 stripLength = 0;
+    quint32 jpegOffset = 0;
+    quint32 jpegLength = 0;
+    QList<quint32> subIfds;
+
+    quint16 count = readShort(offset);
+    for (quint16 i = 0; i < count; i++) {
+        quint32 entry = offset + 2 + i * IFD_ENTRY_SIZE;
+        if (entry + IFD_ENTRY_SIZE > m_tiffLength)
+            break;
+
+        quint16 tag = readShort(entry);
+        if (type == ExifIfd) {
+            switch (tag) {
+            case TAG_DATETIME_ORIGINAL:
+                m_dateTimeOriginal = readDateTime(entry);
+                break;
+            case TAG_DATETIME_DIGITIZED:
+                m_dateTimeDigitized = readDateTime(entry);
+                break;
+            case TAG_PIXEL_X_DIMENSION:
+                m_exifSize.setWidth(readValue(entry));
+                break;
+            case TAG_PIXEL_Y_DIMENSION:
+                m_exifSize.setHeight(readValue(entry));
+                break;
+            }
+            continue;
+        }
+
+        switch (tag) {
+        case TAG_ORIENTATION:
+            if (type == PrimaryIfd) {
+                quint32 orientation = readValue(entry);
+                if (orientation >= MIN_ORIENTATION && orientation <= MAX_ORIENTATION)
+                    m_orientation = static_cast<Orientation>(orientation);
+                // A single SHORT is stored in the entry itself
+                if (readShort(entry + 2) == TYPE_SHORT && readLong(entry + 4) == 1)
+                    m_orientationOffset = m_tiffOffset + entry + 8;
+            }
+            break;
+        case TAG_EXIF_IFD:
+            if (type == PrimaryIfd)
+                exifOffset = readValue(entry);
+            break;
+        case TAG_COMPRESSION:
+            compression = readValue(entry);
+            break;
+        case TAG_STRIP_OFFSETS:
+            // Previews are stored in a single strip
+            if (readLong(entry + 4) == 1)
+                stripOffset = readValue(entry);
+            break;
+        case TAG_STRIP_BYTE_COUNTS:
+            if (readLong(entry + 4) == 1)
+                stripLength = readValue(entry);
+            break;
+        case TAG_JPEG_INTERCHANGE_FORMAT:
+            jpegOffset = readValue(entry);
+            break;
+        case TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
+            jpegLength = readValue(entry);
+            break;
+        case TAG_SUB_IFDS: {
+            quint16 subIfdType = readShort(entry + 2);
+            if (subIfdType != TYPE_LONG && subIfdType != TYPE_IFD)
+                break;
+            quint32 subIfdCount = qMin(readLong(entry + 4), quint32(MAX_IFD_COUNT));
+            quint32 values = (subIfdCount == 1) ? entry + 8 : readLong(entry + 8);
+            for (quint32 j = 0; j < subIfdCount; j++) {
+                if (quint64(values) + 4 * (j + 1) > m_tiffLength)
+                    break;
+                subIfds.append(readLong(values + 4 * j));
+            }
+            break;
+        }
+        }
+    }
+
+    if (exifOffset != 0)
+        parseIfd(exifOffset, ExifIfd);
+
+    quint32 next = offset + 2 + count * IFD_ENTRY_SIZE;
+
+    if (type == ThumbnailIfd) {
+        if (jpegOffset != 0 && jpegOffset <= m_tiffLength && jpegLength <= m_tiffLength - jpegOffset)
+            m_thumbnail = QByteArray(reinterpret_cast<const char*>(m_tiff + jpegOffset), jpegLength);
+        return;
+    }
+
+    if (!m_readPreviews) {
+        if (type == PrimaryIfd && next <= m_tiffLength - 4)
+            parseIfd(readLong(next), ThumbnailIfd);
+        return;
+    }
+
+    if (type == ExifIfd)
+        return;
+
+    if (compression == COMPRESSION_OLD_JPEG || compression == COMPRESSION_JPEG)
+        addPreview(stripOffset, stripLength);
+    addPreview(jpegOffset, jpegLength);
+
+    foreach (quint32 subIfd, subIfds)
+        parseIfd(subIfd, ImageIfd);
+
+    if (next <= m_tiffLength - 4)
+        parseIfd(readLong(next), ImageIfd);
+}
+
+/*!
+ * \brief ExifReader::addPreview keeps the JPEG image at that offset as the
+ * preview, if it's bigger than the one found so far
+ * \param offset
+ * \param length
+ */
+void ExifReader::addPreview(quint32 offset, quint32 length)
+{
+    if (offset == 0 || length == 0 || offset > m_tiffLength || length > m_tiffLength - offset)
+        return;
+
+    QSize size;
+    if (!jpeg_frame_size(m_tiff + offset, length, &size))
+        return;
+
+    if (m_previewLength == 0 ||
+            qint64(size.width()) * size.height() > qint64(m_size.width()) * m_size.height()) {
+        m_size = size;
+        m_previewOffset = offset;
+        m_previewLength = length;
+    }
+}
+
+/*!
+ * \brief ExifReader::readShort
+ * \param offset has to be within the TIFF data
+ * \return
+ */
+quint16 ExifReader::readShort(quint32 offset) const
+{
+    const uchar* data = m_tiff + offset;
+    if (m_bigEndian)
+        return (data[0] << 8) | data[1];
+
+    return data[0] | (data[1] << 8);
+}
+
+/*!
+ * \brief ExifReader::readLong
+ * \param offset has to be within the TIFF data
+ * \return
+ */
+quint32 ExifReader::readLong(quint32 offset) const
+{
+    const uchar* data = m_tiff + offset;
+    if (m_bigEndian)
+        return (quint32(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (quint32(data[3]) << 24);
+}
+
+/*!
+ * \brief ExifReader::readValue
+ * \param entry
+ * \return the value of a SHORT or LONG tag, 0 for other types
+ */
+quint32 ExifReader::readValue(quint32 entry) const
+{
+    quint16 type = readShort(entry + 2);
+    if (type == TYPE_SHORT)
+        return readShort(entry + 8);
+    if (type == TYPE_LONG)
+        return readLong(entry + 8);
+
+    return 0;
+}
+
+/*!
+ * \brief ExifReader::readDateTime
+ * \param entry
+ * \return the date of an ASCII tag, invalid if it can't be parsed
+ */
+QDateTime ExifReader::readDateTime(quint32 entry) const
+{
+    if (readShort(entry + 2) != TYPE_ASCII)
+        return QDateTime();
+
+    quint32 count = readLong(entry + 4);
+    quint32 offset = (count <= 4) ? entry + 8 : readLong(entry + 8);
+    if (offset > m_tiffLength || count > m_tiffLength - offset)
+        return QDateTime();
+
+    QByteArray value(reinterpret_cast<const char*>(m_tiff + offset), count);
+    return PhotoMetadata::parseExifDateTime(value);
+}
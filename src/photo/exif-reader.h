@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GALLERY_EXIF_READER_H_
+#define GALLERY_EXIF_READER_H_
+
+// util
+#include "orientation.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSize>
+#include <QString>
+
+/*!
+ * \brief The ExifReader class reads the few Exif tags needed to import a JPEG
+ * photo straight from the start of the file, without Exiv2.
+ * It also reads camera RAW files, which are TIFF files that embed a big JPEG
+ * preview. These are shown through that preview, so the size is the one of
+ * the preview.
+ * Other files, and JPEG files it can't make sense of, have to be read with
+ * PhotoMetadata.
+ * As the Orientation tag has a fixed size, it can also change its value in
+ * place, without writing the whole file again.
+ */
+class ExifReader
+{
+public:
+    explicit ExifReader(const QString& filename);
+
+    static bool isRawFile(const QFileInfo& file);
+
+    bool read();
+    bool readRaw();
+
+    QDateTime exposureTime() const;
+    Orientation orientation() const;
+    QSize size() const;
+    QByteArray preview() const;
+    QByteArray thumbnail() const;
+
+    bool writeOrientation(Orientation orientation) const;
+
+private:
+    enum IfdType {
+        PrimaryIfd,
+        ExifIfd,
+        ThumbnailIfd,
+        ImageIfd
+    };
+
+    // Only that much of the file is read
+    static const int MAX_HEADER_SIZE;
+    // At most that many IFDs are read, in case they point to each other
+    static const int MAX_IFD_COUNT;
+
+    bool parseJpeg(const QByteArray& data);
+    void parseTiff(const uchar* tiff, int length);
+    void parseIfd(quint32 offset, IfdType type);
+    void addPreview(quint32 offset, quint32 length);
+
+    quint16 readShort(quint32 offset) const;
+    quint32 readLong(quint32 offset) const;
+    quint32 readValue(quint32 entry) const;
+    QDateTime readDateTime(quint32 entry) const;
+
+    QString m_filename;
+    const uchar* m_tiff;
+    quint32 m_tiffLength;
+    qint64 m_tiffOffset;
+    bool m_bigEndian;
+    bool m_readPreviews;
+    int m_ifdCount;
+
+    QDateTime m_dateTimeOriginal;
+    QDateTime m_dateTimeDigitized;
+    Orientation m_orientation;
+    qint64 m_orientationOffset;
+    QSize m_size;
+    QSize m_exifSize;
+    quint32 m_previewOffset;
+    quint32 m_previewLength;
+    QByteArray m_thumbnail;
+};
+
+#endif // GALLERY_EXIF_READER_H_
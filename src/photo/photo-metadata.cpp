@@ -18,6 +18,7 @@
  */
 
 #include "photo-metadata.h"
+#include "exif-reader.h"
 
 #include <cstdio>
 #include <QBuffer>
@@ -49,16 +50,6 @@ const char* EXIF_DATE_FORMATS[] = {
 const size_t NUM_EXIF_DATE_FORMATS = 3;
 const float THUMBNAIL_SCALE = 8.5;
 
-const char* get_first_matched(const char* keys[], size_t n_keys,
-                              const QSet<QString>& in) {
-    for (size_t i = 0; i < n_keys; i++) {
-        if (in.contains(keys[i]))
-            return keys[i];
-    }
-    
-    return NULL;
-}
-
 bool is_xmp_key(const char* key) {
     return (key != NULL) ? (std::strncmp("Xmp.", key, 4) == 0) : false;
 }
@@ -67,6 +58,34 @@ bool is_exif_key(const char* key) {
     return (key != NULL) ? (std::strncmp("Exif.", key, 5) == 0) : false;
 }
 
+// looks the key up in the group it belongs to, so only the Exif or the XMP
+// data gets searched, and nothing is copied
+bool has_key(Exiv2::Image& image, const char* key) {
+    if (is_exif_key(key)) {
+        Exiv2::ExifData& exif_data = image.exifData();
+        return !exif_data.empty() &&
+                exif_data.findKey(Exiv2::ExifKey(key)) != exif_data.end();
+    }
+
+    if (is_xmp_key(key)) {
+        Exiv2::XmpData& xmp_data = image.xmpData();
+        return !xmp_data.empty() &&
+                xmp_data.findKey(Exiv2::XmpKey(key)) != xmp_data.end();
+    }
+
+    return false;
+}
+
+const char* get_first_matched(const char* keys[], size_t n_keys,
+                              Exiv2::Image& image) {
+    for (size_t i = 0; i < n_keys; i++) {
+        if (has_key(image, keys[i]))
+            return keys[i];
+    }
+    
+    return NULL;
+}
+
 // caller should test if 's' could be successfully parsed by invoking the
 // isValid() method on the returned QDateTime instance; if isValid() == false,
 // 's' couldn't be parsed
@@ -123,16 +142,6 @@ PhotoMetadata* PhotoMetadata::fromFile(const char* filepath)
             return NULL;
         }
 
-        Exiv2::ExifData& exif_data = result->m_image->exifData();
-        Exiv2::ExifData::const_iterator end = exif_data.end();
-        for (Exiv2::ExifData::const_iterator i = exif_data.begin(); i != end; i++)
-            result->m_keysPresent.insert(QString(i->key().c_str()));
-
-        Exiv2::XmpData& xmp_data = result->m_image->xmpData();
-        Exiv2::XmpData::const_iterator end1 = xmp_data.end();
-        for (Exiv2::XmpData::const_iterator i = xmp_data.begin(); i != end1; i++)
-            result->m_keysPresent.insert(QString(i->key().c_str()));
-
         return result;
     } catch (Exiv2::AnyError& e) {
         qDebug("Error loading image metadata: %s", e.what());
@@ -162,16 +171,27 @@ Orientation PhotoMetadata::orientation() const
     if (exif_data.empty())
         return DEFAULT_ORIENTATION;
 
-    if (m_keysPresent.find(EXIF_ORIENTATION_KEY) == m_keysPresent.end())
+    Exiv2::ExifData::const_iterator it = exif_data.findKey(Exiv2::ExifKey(EXIF_ORIENTATION_KEY));
+    if (it == exif_data.end())
         return DEFAULT_ORIENTATION;
 
-    long orientation_code = exif_data[EXIF_ORIENTATION_KEY].toLong();
+    long orientation_code = it->toLong();
     if (orientation_code < MIN_ORIENTATION || orientation_code > MAX_ORIENTATION)
         return DEFAULT_ORIENTATION;
 
     return static_cast<Orientation>(orientation_code);
 }
 
+/*!
+ * \brief PhotoMetadata::parseExifDateTime
+ * \param value an Exif date, as stored in the DateTime tags
+ * \return invalid if the date could not be parsed
+ */
+QDateTime PhotoMetadata::parseExifDateTime(const QByteArray& value)
+{
+    return parse_exif_date_string(value.constData());
+}
+
 /*!
  * \brief PhotoMetadata::exposureTime
  * \return
@@ -179,7 +199,7 @@ Orientation PhotoMetadata::orientation() const
 QDateTime PhotoMetadata::exposureTime() const
 {
     const char* matched = get_first_matched(EXPOSURE_TIME_KEYS,
-                                            NUM_EXPOSURE_TIME_KEYS, m_keysPresent);
+                                            NUM_EXPOSURE_TIME_KEYS, *m_image);
     if (matched == NULL)
         return QDateTime();
 
@@ -220,9 +240,33 @@ void PhotoMetadata::setOrientation(Orientation orientation)
     Exiv2::ExifData& exif_data = m_image->exifData();
 
     exif_data[EXIF_ORIENTATION_KEY] = (Exiv2::UShortValue)orientation;
+}
+
+/*!
+ * \brief PhotoMetadata::writeOrientation changes the orientation stored in a
+ * photo file. If it already has an Orientation tag, only its value gets
+ * overwritten in place. Otherwise the tag is added by Exiv2, which writes the
+ * whole file again.
+ * \param file
+ * \param orientation
+ * \return false if the file could not be changed
+ */
+bool PhotoMetadata::writeOrientation(const QFileInfo& file, Orientation orientation)
+{
+    ExifReader reader(file.absoluteFilePath());
+    bool read = ExifReader::isRawFile(file) ? reader.readRaw() : reader.read();
+    if (read && reader.writeOrientation(orientation))
+        return true;
+
+    PhotoMetadata* metadata = fromFile(file);
+    if (metadata == NULL)
+        return false;
 
-    if (!m_keysPresent.contains(EXIF_ORIENTATION_KEY))
-        m_keysPresent.insert(EXIF_ORIENTATION_KEY);
+    metadata->setOrientation(orientation);
+    bool saved = metadata->save();
+    delete metadata;
+
+    return saved;
 }
 
 /*!
@@ -241,9 +285,6 @@ void PhotoMetadata::setDateTimeDigitized(const QDateTime& digitized)
  
         exif_data[EXIF_DATETIMEDIGITIZED_KEY] = digitized.toString("yyyy:MM:dd hh:mm:ss").toStdString();
  
-        if (!m_keysPresent.contains(EXIF_DATETIMEDIGITIZED_KEY))
-            m_keysPresent.insert(EXIF_DATETIMEDIGITIZED_KEY);
- 
     } catch (Exiv2::AnyError& e) {
         qDebug("Do not set DateTimeDigitized, error reading image metadata; %s", e.what());
         return;
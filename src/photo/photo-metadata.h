@@ -27,7 +27,6 @@
 #include <QFileInfo>
 #include <QObject>
 #include <QString>
-#include <QSet>
 #include <QTransform>
 #include <QImage>
 
@@ -43,6 +42,8 @@ class PhotoMetadata : public QObject
 public:
     static PhotoMetadata* fromFile(const char* filepath);
     static PhotoMetadata* fromFile(const QFileInfo& file);
+    static QDateTime parseExifDateTime(const QByteArray& value);
+    static bool writeOrientation(const QFileInfo& file, Orientation orientation);
 
     QDateTime exposureTime() const;
     Orientation orientation() const;
@@ -60,7 +61,6 @@ private:
     PhotoMetadata(const char* filepath);
     
     Exiv2::Image::AutoPtr m_image;
-    QSet<QString> m_keysPresent;
     QFileInfo m_fileSourceInfo;
 };
 
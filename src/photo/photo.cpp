@@ -33,6 +33,9 @@
 // medialoader
 #include "photo-metadata.h"
 
+// photo
+#include "exif-reader.h"
+
 // util
 #include "imaging.h"
 
@@ -40,10 +43,25 @@
 #include "gallery-manager.h"
 
 #include <QApplication>
+#include <QDebug>
 #include <QFileInfo>
+#include <QHash>
 #include <QImage>
 #include <QImageReader>
 #include <QImageWriter>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSet>
+#include <QThreadPool>
+
+namespace {
+// Orientations that still have to be written, by the path of the photo
+QMutex pendingOrientationsMutex;
+QHash<QString, Orientation> pendingOrientations;
+// Paths of the photos an OrientationWriter is running for
+QSet<QString> writingOrientations;
+} // namespace
 
 /*!
  * \brief Photo::isValid
@@ -58,6 +76,10 @@ bool Photo::isValid(const QFileInfo& file)
         return false;
     }
 
+    // Camera RAW files are shown through the JPEG preview they embed
+    if (ExifReader::isRawFile(file))
+        return ExifReader(file.absoluteFilePath()).readRaw();
+
     QImageReader reader(file.filePath());
     QByteArray format = reader.format();
 
@@ -81,8 +103,13 @@ Photo::Photo(const QFileInfo& file)
       m_originalSize(),
       m_originalOrientation(TOP_LEFT_ORIGIN)
 {
-    QByteArray format = QImageReader(file.filePath()).format();
-    m_fileFormat = QString(format).toLower();
+    if (ExifReader::isRawFile(file)) {
+        // Only the embedded preview is read, so it can't be edited
+        m_fileFormat = "raw";
+    } else {
+        QByteArray format = QImageReader(file.filePath()).format();
+        m_fileFormat = QString(format).toLower();
+    }
     Q_EMIT canBeEditedChanged();
     if (m_fileFormat == "jpg") // Why does Qt expose two different names here?
         m_fileFormat = "jpeg";
@@ -156,7 +183,11 @@ bool Photo::fileFormatHasOrientation() const
  */
 void Photo::setOriginalOrientation(Orientation orientation)
 {
+    if (m_originalOrientation == orientation)
+        return;
+
     m_originalOrientation = orientation;
+    emit orientationChanged();
 }
 
 /*!
@@ -168,6 +199,90 @@ Orientation Photo::originalOrientation() const
     return m_originalOrientation;
 }
 
+/*!
+ * \brief Photo::rotateLeft
+ */
+void Photo::rotateLeft()
+{
+    rotate(QList<Photo*>() << this, true);
+}
+
+/*!
+ * \brief Photo::rotateRight
+ */
+void Photo::rotateRight()
+{
+    rotate(QList<Photo*>() << this, false);
+}
+
+/*!
+ * \brief Photo::rotate rotates the photos by changing their orientation. The
+ * photos show the new orientation right away, while the files are written in
+ * parallel in the global thread pool. Photos of formats without an
+ * orientation are skipped.
+ * \param photos
+ * \param left
+ */
+void Photo::rotate(const QList<Photo*>& photos, bool left)
+{
+    QList<QPair<Photo*, Orientation> > rotated;
+    {
+        QMutexLocker locker(&pendingOrientationsMutex);
+        foreach (Photo* photo, photos) {
+            if (!photo->fileFormatHasOrientation())
+                continue;
+
+            Orientation oldOrientation = photo->m_originalOrientation;
+            Orientation orientation = OrientationCorrection::rotateOrientation(oldOrientation, left);
+            rotated.append(qMakePair(photo, orientation));
+
+            QString path = photo->file().absoluteFilePath();
+            pendingOrientations.insert(path, orientation);
+            if (!writingOrientations.contains(path)) {
+                writingOrientations.insert(path);
+                OrientationWriter *writer = new OrientationWriter(path, oldOrientation);
+                QObject::connect(writer, SIGNAL(writeFailed(int)),
+                                 photo, SLOT(onOrientationWriteFailed(int)), Qt::QueuedConnection);
+                QThreadPool::globalInstance()->start(writer);
+            }
+        }
+    }
+
+    // Not under the lock, as it notifies QML and writes to the database
+    for (int i = 0; i < rotated.size(); i++)
+        rotated[i].first->storeOrientation(rotated[i].second);
+}
+
+/*!
+ * \brief Photo::storeOrientation shows the photo in that orientation, and
+ * stores it in the database
+ * \param orientation
+ */
+void Photo::storeOrientation(Orientation orientation)
+{
+    setOriginalOrientation(orientation);
+
+    if (id() != INVALID_ID && mediaTable())
+        mediaTable()->setOriginalOrientation(id(), orientation);
+}
+
+/*!
+ * \brief Photo::onOrientationWriteFailed goes back to the orientation the
+ * file has. If the photo got rotated again meanwhile, the writer of that
+ * rotation decides instead.
+ * \param orientation
+ */
+void Photo::onOrientationWriteFailed(int orientation)
+{
+    {
+        QMutexLocker locker(&pendingOrientationsMutex);
+        if (writingOrientations.contains(file().absoluteFilePath()))
+            return;
+    }
+
+    storeOrientation(static_cast<Orientation>(orientation));
+}
+
 /*!
  * \brief Photo::originalSize
  * \return
@@ -177,6 +292,16 @@ const QSize &Photo::originalSize()
     return m_originalSize;
 }
 
+/*!
+ * \brief Photo::isRaw
+ * \return true for camera RAW files, which are shown through their embedded
+ * JPEG preview
+ */
+bool Photo::isRaw() const
+{
+    return m_fileFormat == "raw";
+}
+
 /*!
  * \brief Photo::originalSize
  * \return
@@ -185,3 +310,50 @@ bool Photo::canBeEdited() const
 {
     return QImageWriter::supportedImageFormats().contains(m_fileFormat.toUtf8());
 }
+
+/*!
+ * \brief OrientationWriter::OrientationWriter until there are no more pending
+ * orientations for the photo, no other writer is started for it, so quick
+ * rotations of the same photo are written in order
+ * \param path
+ * \param writtenOrientation the orientation the file has now
+ */
+OrientationWriter::OrientationWriter(const QString& path, Orientation writtenOrientation)
+    : QObject(),
+      m_path(path),
+      m_writtenOrientation(writtenOrientation)
+{
+    // Deleted in the thread it belongs to, once done
+    setAutoDelete(false);
+}
+
+/*!
+ * \brief OrientationWriter::run writes the pending orientations of the photo.
+ * If the last one can't be written, writeFailed() reports the orientation the
+ * file has instead.
+ */
+void OrientationWriter::run()
+{
+    bool failed = false;
+    forever {
+        Orientation orientation = TOP_LEFT_ORIGIN;
+        {
+            QMutexLocker locker(&pendingOrientationsMutex);
+            if (!pendingOrientations.contains(m_path)) {
+                writingOrientations.remove(m_path);
+                if (failed)
+                    emit writeFailed(m_writtenOrientation);
+                break;
+            }
+            orientation = pendingOrientations.take(m_path);
+        }
+
+        failed = !PhotoMetadata::writeOrientation(QFileInfo(m_path), orientation);
+        if (failed)
+            qDebug() << "Can't write the orientation of" << m_path;
+        else
+            m_writtenOrientation = orientation;
+    }
+
+    deleteLater();
+}
@@ -28,6 +28,8 @@
 // util
 #include "orientation.h"
 
+#include <QRunnable>
+
 /*!
  * \brief The Photo class
  */
@@ -36,6 +38,7 @@ class Photo : public MediaSource
     Q_OBJECT
 
     Q_PROPERTY(bool canBeEdited READ canBeEdited NOTIFY canBeEditedChanged)
+    Q_PROPERTY(bool raw READ isRaw CONSTANT)
 public:
     explicit Photo(const QFileInfo& file);
     virtual ~Photo();
@@ -47,9 +50,14 @@ public:
     virtual Orientation orientation() const;
 
     bool canBeEdited() const;
+    bool isRaw() const;
 
     void setOriginalOrientation(Orientation orientation);
     Orientation originalOrientation() const;
+
+    Q_INVOKABLE void rotateLeft();
+    Q_INVOKABLE void rotateRight();
+    static void rotate(const QList<Photo*>& photos, bool left);
     const QSize &originalSize();
 
     const QString &fileFormat() const;
@@ -62,7 +70,11 @@ signals:
 protected:
     virtual void destroySource(bool destroyBacking, bool asOrphan);
 
+private slots:
+    void onOrientationWriteFailed(int orientation);
+
 private:
+    void storeOrientation(Orientation orientation);
     void appendPathParams(QUrl* url, Orientation orientation, const int sizeLevel) const;
 
     QString m_fileFormat;
@@ -72,4 +84,26 @@ private:
     Orientation m_originalOrientation;
 };
 
+/*!
+ * \brief The OrientationWriter class writes the rotations of a photo to its
+ * file, in the global thread pool
+ */
+class OrientationWriter : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    OrientationWriter(const QString& path, Orientation writtenOrientation);
+
+    virtual void run();
+
+signals:
+    void writeFailed(int writtenOrientation);
+
+private:
+    QString m_path;
+    // What the file has, after the last successful write
+    Orientation m_writtenOrientation;
+};
+
 #endif  // GALLERY_PHOTO_H_
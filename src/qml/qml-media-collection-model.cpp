@@ -37,6 +37,9 @@
 #include "media-source.h"
 #include "media-collection.h"
 
+// photo
+#include "photo.h"
+
 // util
 #include "variants.h"
 
@@ -103,6 +106,28 @@ void QmlMediaCollectionModel::destroySelectedMedia()
     } 
 }
 
+/*!
+ * \brief QmlMediaCollectionModel::rotateSelectedMedia rotates all the selected
+ * photos at once, so their files get written in parallel
+ * \param left
+ */
+void QmlMediaCollectionModel::rotateSelectedMedia(bool left)
+{
+    SelectableViewCollection* view = backingViewCollection();
+    if (view->selectedCount() == 0)
+        return;
+
+    QList<Photo*> photos;
+    QSetIterator<DataObject *> i(view->getSelected());
+    while (i.hasNext()) {
+        Photo* photo = qobject_cast<Photo*>(i.next());
+        if (photo != NULL)
+            photos.append(photo);
+    }
+
+    Photo::rotate(photos, left);
+}
+
 /*!
  * \brief QmlMediaCollectionModel::destroyMedia
  * \param vmedia
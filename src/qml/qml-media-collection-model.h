@@ -47,6 +47,7 @@ public:
 
     Q_INVOKABLE QVariant createAlbumFromSelected();
     Q_INVOKABLE void destroySelectedMedia();
+    Q_INVOKABLE void rotateSelectedMedia(bool left);
     Q_INVOKABLE void destroyMedia(QVariant vmedia, bool destroy_backing);
     Q_INVOKABLE void removeMediaFromAlbum(QVariant valbum, QVariant vmedia);
 
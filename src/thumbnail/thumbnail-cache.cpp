@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thumbnail-cache.h"
+
+// photo
+#include "exif-reader.h"
+#include "photo-metadata.h"
+
+// util
+#include "imaging.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QImageReader>
+#include <QMutexLocker>
+
+#include <string.h>
+
+const int ThumbnailCacheWorker::IDLE_DELAY = 3000;
+const int ThumbnailCacheWorker::STEP_DELAY = 20;
+
+// Edge lengths of the thumbnails of each level, in pixels
+static const int LEVEL_SIZES[ThumbnailCache::LevelCount] = { 128, 256, 512 };
+// Default budgets of the memory and the disk cache, in bytes
+static const int DEFAULT_MEMORY_BUDGET = 32 * 1024 * 1024;
+static const qint64 DEFAULT_DISK_BUDGET = 256 * 1024 * 1024;
+static const int THUMBNAIL_QUALITY = 90;
+// Biggest factor a JPEG image can be scaled down by while decoding it
+static const int MAX_JPEG_SCALE_DENOMINATOR = 8;
+
+/*!
+ * \brief ThumbnailCache::ThumbnailCache
+ * \param directory the thumbnails are stored there
+ * \param parent
+ */
+ThumbnailCache::ThumbnailCache(const QString& directory, QObject *parent)
+    : QObject(parent),
+      m_directory(directory),
+      m_store(directory),
+      m_memoryCache(DEFAULT_MEMORY_BUDGET),
+      m_diskBudget(DEFAULT_DISK_BUDGET),
+      m_workerThread(this)
+{
+    // Thumbnails used to be stored in one file each, in a directory per level
+    for (int level = Small; level < LevelCount; level++)
+        QDir(m_directory + QDir::separator() + QString::number(LEVEL_SIZES[level])).removeRecursively();
+
+    m_worker = new ThumbnailCacheWorker(this);
+    m_worker->moveToThread(&m_workerThread);
+    QObject::connect(&m_workerThread, SIGNAL(finished()),
+                     m_worker, SLOT(deleteLater()));
+
+    m_workerThread.start(QThread::LowPriority);
+
+    // The last run may have left more than fits into the budget
+    scheduleCleanUp();
+}
+
+/*!
+ * \brief ThumbnailCache::~ThumbnailCache
+ */
+ThumbnailCache::~ThumbnailCache()
+{
+    m_workerThread.quit();
+    m_workerThread.wait();
+}
+
+/*!
+ * \brief ThumbnailCache::levelSize
+ * \param level
+ * \return the length of the shorter edge of the thumbnails of that level
+ */
+int ThumbnailCache::levelSize(Level level)
+{
+    Q_ASSERT(level >= Small && level < LevelCount);
+    return LEVEL_SIZES[level];
+}
+
+/*!
+ * \brief ThumbnailCache::levelForSize
+ * \param requestedSize
+ * \return the smallest level that is big enough for the requested size, or
+ * LevelCount if the size is bigger than all the levels, or not given at all
+ */
+ThumbnailCache::Level ThumbnailCache::levelForSize(const QSize& requestedSize)
+{
+    int size = qMax(requestedSize.width(), requestedSize.height());
+    if (size <= 0)
+        return LevelCount;
+
+    for (int level = Small; level < LevelCount; level++) {
+        if (size <= LEVEL_SIZES[level])
+            return static_cast<Level>(level);
+    }
+
+    return LevelCount;
+}
+
+/*!
+ * \brief ThumbnailCache::readImage reads a photo, or the preview of a RAW
+ * file, scaled down to cover the given size, and rotated by its orientation
+ * \param file
+ * \param size a width or height of 0 or less is derived from the other one.
+ * If both are, the image is not scaled
+ * \return a null image if the file can't be read
+ */
+QImage ThumbnailCache::readImage(const QFileInfo& file, const QSize& size)
+{
+    QImageReader reader;
+    QByteArray preview;
+    QBuffer previewBuffer(&preview);
+
+    Orientation orientation = TOP_LEFT_ORIGIN;
+    ExifReader exifReader(file.absoluteFilePath());
+    if (ExifReader::isRawFile(file)) {
+        // Demosaicing the sensor data takes far too long, so RAW files are
+        // shown through the JPEG preview they embed
+        if (exifReader.readRaw())
+            preview = exifReader.preview();
+        orientation = exifReader.orientation();
+        reader.setDevice(&previewBuffer);
+    } else {
+        reader.setFileName(file.absoluteFilePath());
+        if (reader.format() == "jpeg" && exifReader.read()) {
+            orientation = exifReader.orientation();
+        } else {
+            PhotoMetadata *metadata = PhotoMetadata::fromFile(file);
+            if (metadata) {
+                orientation = metadata->orientation();
+                delete metadata;
+            }
+        }
+    }
+
+    // The size is the one of the image as shown, so of the rotated image
+    QSize boundingSize(qMax(size.width(), 0), qMax(size.height(), 0));
+    if (orientation >= LEFT_TOP_ORIGIN)
+        boundingSize.transpose();
+
+    QSize imageSize = reader.size();
+    QSize scaledSize = imageSize;
+    if (!boundingSize.isNull())
+        scaledSize.scale(boundingSize, Qt::KeepAspectRatioByExpanding);
+
+    if (reader.format() == "jpeg" && imageSize.isValid() && scaledSize.width() < imageSize.width())
+        reader.setScaledSize(jpegDecodeSize(imageSize, scaledSize));
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qDebug() << "Can't read" << file.absoluteFilePath() << reader.errorString();
+        return image;
+    }
+
+    if (!imageSize.isValid()) {
+        scaledSize = image.size();
+        if (!boundingSize.isNull())
+            scaledSize.scale(boundingSize, Qt::KeepAspectRatioByExpanding);
+    }
+
+    return scaleAndOrient(image, scaledSize, orientation);
+}
+
+/*!
+ * \brief ThumbnailCache::jpegDecodeSize the JPEG decoder can scale the image
+ * down by 1/2, 1/4 or 1/8 while decoding it, which takes a fraction of the
+ * time and memory of decoding the full image
+ * \param imageSize
+ * \param size the size the image gets scaled to afterwards
+ * \return the smallest size the image can be decoded to, that is still at
+ * least as big as size. libjpeg rounds the scaled dimensions up, and any
+ * other size makes Qt scale the decoded image once more.
+ */
+QSize ThumbnailCache::jpegDecodeSize(const QSize& imageSize, const QSize& size)
+{
+    int denominator = MAX_JPEG_SCALE_DENOMINATOR;
+    QSize decodeSize;
+    forever {
+        decodeSize = QSize((imageSize.width() + denominator - 1) / denominator,
+                           (imageSize.height() + denominator - 1) / denominator);
+        if (denominator == 1 || (decodeSize.width() >= size.width() &&
+                                 decodeSize.height() >= size.height()))
+            break;
+        denominator /= 2;
+    }
+
+    return decodeSize;
+}
+
+/*!
+ * \brief ThumbnailCache::thumbnail returns the thumbnail from memory, from
+ * disk, or generates it if it doesn't exist yet. This is called by the image
+ * provider threads.
+ * \param file
+ * \param level
+ * \return a null image if the photo can't be read
+ */
+QImage ThumbnailCache::thumbnail(const QFileInfo& file, Level level)
+{
+    scheduleCleanUp();
+
+    quint64 fileKey = key(file);
+    QString memoryKey = QString::number(fileKey) + QLatin1Char('-') + QString::number(level);
+    {
+        QMutexLocker locker(&m_mutex);
+        QImage *cached = m_memoryCache.object(memoryKey);
+        if (cached)
+            return *cached;
+    }
+
+    QImage thumbnail = QImage::fromData(m_store.find(fileKey, level), "JPG");
+    if (thumbnail.isNull()) {
+        int size = levelSize(level);
+        thumbnail = readImage(file, QSize(size, size));
+        if (thumbnail.isNull())
+            return thumbnail;
+
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        if (thumbnail.save(&buffer, "JPG", THUMBNAIL_QUALITY))
+            m_store.insert(fileKey, level, data);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_memoryCache.insert(memoryKey, new QImage(thumbnail), thumbnail.byteCount());
+
+    return thumbnail;
+}
+
+/*!
+ * \brief ThumbnailCache::move keeps the thumbnails of a photo that got moved
+ * to another path
+ * \param oldPath
+ * \param oldModified the modification time of the photo at the old path
+ * \param file the photo at the new path
+ */
+void ThumbnailCache::move(const QString& oldPath, const QDateTime& oldModified,
+                          const QFileInfo& file)
+{
+    quint64 oldKey = key(oldPath, oldModified);
+    quint64 newKey = key(file);
+    for (int level = Small; level < LevelCount; level++)
+        m_store.move(oldKey, newKey, level);
+}
+
+/*!
+ * \brief ThumbnailCache::setMemoryBudget
+ * \param bytes
+ */
+void ThumbnailCache::setMemoryBudget(int bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryCache.setMaxCost(bytes);
+}
+
+/*!
+ * \brief ThumbnailCache::setDiskBudget the least recently used thumbnails get
+ * removed, once all of them take more space
+ * \param bytes
+ */
+void ThumbnailCache::setDiskBudget(qint64 bytes)
+{
+    m_diskBudget = bytes;
+}
+
+/*!
+ * \brief ThumbnailCache::cleanUp does one step of the clean up of the store
+ * \return true if there are more steps to do
+ */
+bool ThumbnailCache::cleanUp()
+{
+    return m_store.cleanUp(m_diskBudget);
+}
+
+/*!
+ * \brief ThumbnailCache::key
+ * \param path
+ * \param modified
+ * \return identifies the thumbnails of a photo, as long as it's not changed
+ */
+quint64 ThumbnailCache::key(const QString& path, const QDateTime& modified)
+{
+    QByteArray id = path.toUtf8() + '\n' + QByteArray::number(modified.toMSecsSinceEpoch());
+    QByteArray hash = QCryptographicHash::hash(id, QCryptographicHash::Md5);
+
+    quint64 key;
+    memcpy(&key, hash.constData(), sizeof(key));
+    return key;
+}
+
+/*!
+ * \brief ThumbnailCache::key
+ * \param file
+ * \return
+ */
+quint64 ThumbnailCache::key(const QFileInfo& file)
+{
+    return key(file.absoluteFilePath(), file.lastModified());
+}
+
+/*!
+ * \brief ThumbnailCache::scheduleCleanUp
+ */
+void ThumbnailCache::scheduleCleanUp()
+{
+    QMetaObject::invokeMethod(m_worker, "scheduleCleanUp", Qt::QueuedConnection);
+}
+
+/*!
+ * \brief ThumbnailCacheWorker::ThumbnailCacheWorker
+ * \param cache
+ * \param parent
+ */
+ThumbnailCacheWorker::ThumbnailCacheWorker(ThumbnailCache *cache, QObject *parent)
+    : QObject(parent),
+      m_cache(cache),
+      m_cleanUpTimer(this)
+{
+    m_cleanUpTimer.setSingleShot(true);
+    QObject::connect(&m_cleanUpTimer, SIGNAL(timeout()),
+                     this, SLOT(onCleanUpTimeout()));
+}
+
+/*!
+ * \brief ThumbnailCacheWorker::scheduleCleanUp (re)starts waiting for the
+ * thumbnail requests to stop. A running clean up is paused meanwhile.
+ */
+void ThumbnailCacheWorker::scheduleCleanUp()
+{
+    m_cleanUpTimer.start(IDLE_DELAY);
+}
+
+/*!
+ * \brief ThumbnailCacheWorker::onCleanUpTimeout
+ */
+void ThumbnailCacheWorker::onCleanUpTimeout()
+{
+    if (m_cache->cleanUp())
+        m_cleanUpTimer.start(STEP_DELAY);
+}
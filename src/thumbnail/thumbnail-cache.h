@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GALLERY_THUMBNAIL_CACHE_H_
+#define GALLERY_THUMBNAIL_CACHE_H_
+
+#include "thumbnail-store.h"
+
+#include <QCache>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSize>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+
+class ThumbnailCacheWorker;
+
+/*!
+ * \brief The ThumbnailCache class generates the thumbnails of the photos in a
+ * few fixed sizes, and keeps them in a ThumbnailStore and in memory.
+ * A thumbnail is identified by the path and the modification time of its
+ * photo, so a changed photo gets new thumbnails. The old ones are evicted as
+ * the least recently used ones, a few at a time while no thumbnails are
+ * requested.
+ */
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Level {
+        Small = 0,
+        Medium,
+        Large,
+        LevelCount
+    };
+
+    explicit ThumbnailCache(const QString& directory, QObject *parent = 0);
+    virtual ~ThumbnailCache();
+
+    static int levelSize(Level level);
+    static Level levelForSize(const QSize& requestedSize);
+    static QImage readImage(const QFileInfo& file, const QSize& size);
+
+    QImage thumbnail(const QFileInfo& file, Level level);
+    void move(const QString& oldPath, const QDateTime& oldModified, const QFileInfo& file);
+
+    void setMemoryBudget(int bytes);
+    void setDiskBudget(qint64 bytes);
+
+    bool cleanUp();
+
+private:
+    static QSize jpegDecodeSize(const QSize& imageSize, const QSize& size);
+
+    static quint64 key(const QString& path, const QDateTime& modified);
+    static quint64 key(const QFileInfo& file);
+    void scheduleCleanUp();
+
+    QString m_directory;
+    ThumbnailStore m_store;
+    QCache<QString, QImage> m_memoryCache;
+    QMutex m_mutex;
+    qint64 m_diskBudget;
+
+    ThumbnailCacheWorker *m_worker;
+    QThread m_workerThread;
+
+    friend class tst_ThumbnailCache;
+};
+
+/*!
+ * \brief The ThumbnailCacheWorker class cleans up the cache in a thread, once
+ * no more thumbnails were requested for a while
+ */
+class ThumbnailCacheWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailCacheWorker(ThumbnailCache *cache, QObject *parent = 0);
+
+public slots:
+    void scheduleCleanUp();
+    void onCleanUpTimeout();
+
+private:
+    // Time without thumbnail requests, before the clean up starts
+    static const int IDLE_DELAY;
+    // Time between two steps of the clean up
+    static const int STEP_DELAY;
+
+    ThumbnailCache *m_cache;
+    QTimer m_cleanUpTimer;
+};
+
+#endif // GALLERY_THUMBNAIL_CACHE_H_
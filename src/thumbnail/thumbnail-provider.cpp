@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thumbnail-provider.h"
+#include "thumbnail-cache.h"
+
+#include <QFileInfo>
+#include <QUrl>
+
+const char* ThumbnailProvider::PROVIDER_ID = "thumbnail";
+
+/*!
+ * \brief ThumbnailProvider::ThumbnailProvider
+ * \param cache
+ */
+ThumbnailProvider::ThumbnailProvider(ThumbnailCache *cache)
+    : QQuickImageProvider(QQuickImageProvider::Image,
+                          QQmlImageProviderBase::ForceAsynchronousImageLoading),
+      m_cache(cache)
+{
+}
+
+/*!
+ * \brief ThumbnailProvider::requestImage
+ * \param id the url of the photo. A query like "?at=<timestamp>" is ignored,
+ * it's only used by QML to request the thumbnail again after a change
+ * \param size
+ * \param requestedSize
+ * \return
+ */
+QImage ThumbnailProvider::requestImage(const QString& id, QSize* size,
+                                       const QSize& requestedSize)
+{
+    QUrl url(id);
+    QFileInfo file(url.isLocalFile() ? url.toLocalFile() : url.path());
+
+    QImage image;
+    ThumbnailCache::Level level = ThumbnailCache::levelForSize(requestedSize);
+    if (level == ThumbnailCache::LevelCount)
+        image = ThumbnailCache::readImage(file, requestedSize);
+    else
+        image = m_cache->thumbnail(file, level);
+
+    if (size)
+        *size = image.size();
+
+    return image;
+}
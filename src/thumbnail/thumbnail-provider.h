@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GALLERY_THUMBNAIL_PROVIDER_H_
+#define GALLERY_THUMBNAIL_PROVIDER_H_
+
+#include <QQuickImageProvider>
+
+class ThumbnailCache;
+
+/*!
+ * \brief The ThumbnailProvider class serves the thumbnails of the photos to
+ * QML, as image://thumbnail/<photo url>
+ * Requests up to the biggest level of the ThumbnailCache are served from the
+ * cache, bigger ones are read from the photo directly.
+ */
+class ThumbnailProvider : public QQuickImageProvider
+{
+public:
+    static const char* PROVIDER_ID;
+
+    explicit ThumbnailProvider(ThumbnailCache *cache);
+
+    virtual QImage requestImage(const QString& id, QSize* size,
+                                const QSize& requestedSize);
+
+private:
+    ThumbnailCache *m_cache;
+};
+
+#endif // GALLERY_THUMBNAIL_PROVIDER_H_
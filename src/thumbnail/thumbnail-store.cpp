@@ -0,0 +1,680 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thumbnail-store.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QHashIterator>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QStringList>
+#include <QVector>
+#include <QWriteLocker>
+
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+
+// Identifies the index file, and the layout of the header and the slots
+static const char INDEX_MAGIC[8] = { 'G', 'A', 'L', 'T', 'H', 'U', 'M', 'B' };
+static const quint32 INDEX_FORMAT = 1;
+
+static const QLatin1String INDEX_FILE_NAME("thumbnails.index");
+static const QLatin1String PACK_FILE_PREFIX("thumbnails-");
+static const QLatin1String PACK_FILE_SUFFIX(".pack");
+
+// Number of slots of a new index, has to be a power of 2
+static const quint32 MIN_CAPACITY = 4096;
+// A new pack is started once the current one is that big
+static const qint64 MAX_PACK_SIZE = 32 * 1024 * 1024;
+// A pack gets compacted once more than that percentage of it is dead
+static const int COMPACTION_THRESHOLD = 50;
+// Number of thumbnails moved by one step of the compaction
+static const int COMPACTION_BATCH = 50;
+// Number of thumbnails removed by one step of the eviction
+static const int EVICTION_BATCH = 50;
+
+// Keys with a special meaning in the slots
+static const quint64 EMPTY_KEY = 0;
+static const quint64 REMOVED_KEY = 1;
+
+/*!
+ * \brief The ThumbnailStore::Header struct is at the start of the index file
+ */
+struct ThumbnailStore::Header {
+    char magic[8];
+    quint32 format;
+    quint32 capacity;
+    quint32 count;
+    quint32 removed;
+    quint32 currentPack;
+    quint32 reserved;
+};
+
+/*!
+ * \brief The ThumbnailStore::Slot struct is one entry of the hash table in
+ * the index file. It tells where the data of one thumbnail is.
+ * The table uses linear probing, so a removed entry has to stay as
+ * REMOVED_KEY until the table is rebuilt.
+ */
+struct ThumbnailStore::Slot {
+    quint64 key;
+    quint32 offset;
+    quint32 length;
+    quint32 lastUsed;
+    quint16 pack;
+    quint16 level;
+};
+
+/*!
+ * \brief validKey
+ * \param key
+ * \return the key, moved out of the range of the special keys
+ */
+static quint64 validKey(quint64 key)
+{
+    return key > REMOVED_KEY ? key : key + 2;
+}
+
+/*!
+ * \brief currentTime
+ * \return the time in seconds, as stored as last use of a thumbnail
+ */
+static quint32 currentTime()
+{
+    return QDateTime::currentMSecsSinceEpoch() / 1000;
+}
+
+/*!
+ * \brief ThumbnailStore::ThumbnailStore
+ * \param directory the index and the packs are stored there
+ */
+ThumbnailStore::ThumbnailStore(const QString& directory)
+    : m_directory(directory),
+      m_index(0),
+      m_header(0),
+      m_slots(0),
+      m_maxPackSize(MAX_PACK_SIZE)
+{
+    QDir().mkpath(m_directory);
+
+    if (!openIndex()) {
+        // Nothing in the packs can be found without the index
+        QDir dir(m_directory);
+        QStringList packs = dir.entryList(QStringList() << PACK_FILE_PREFIX + "*" + PACK_FILE_SUFFIX,
+                                          QDir::Files);
+        foreach (const QString& pack, packs)
+            dir.remove(pack);
+
+        createIndex(MIN_CAPACITY, 0);
+    }
+
+    openPacks();
+}
+
+/*!
+ * \brief ThumbnailStore::~ThumbnailStore
+ */
+ThumbnailStore::~ThumbnailStore()
+{
+    if (m_header)
+        recordAccesses();
+    qDeleteAll(m_packs);
+    closeIndex();
+}
+
+/*!
+ * \brief ThumbnailStore::find
+ * \param key
+ * \param level
+ * \return the data of the thumbnail, empty if it's not stored
+ */
+QByteArray ThumbnailStore::find(quint64 key, int level)
+{
+    QReadLocker locker(&m_lock);
+    if (!m_header)
+        return QByteArray();
+
+    Slot *slot = findSlot(validKey(key), level);
+    if (!slot)
+        return QByteArray();
+
+    QFile *pack = m_packs.value(slot->pack);
+    if (!pack)
+        return QByteArray();
+
+    QByteArray data(slot->length, Qt::Uninitialized);
+    if (::pread(pack->handle(), data.data(), slot->length, slot->offset) != ssize_t(slot->length))
+        return QByteArray();
+
+    // Other threads might find the same thumbnail, so the slot isn't written
+    // here
+    QMutexLocker accessesLocker(&m_accessesMutex);
+    m_accesses.insert(qMakePair(slot->key, level), currentTime());
+    return data;
+}
+
+/*!
+ * \brief ThumbnailStore::insert appends the data to the current pack. A
+ * thumbnail with the same key and level that is already stored becomes dead
+ * space.
+ * \param key
+ * \param level
+ * \param data
+ */
+void ThumbnailStore::insert(quint64 key, int level, const QByteArray& data)
+{
+    QWriteLocker locker(&m_lock);
+    if (!m_header)
+        return;
+
+    recordAccesses();
+
+    QFile *pack = currentPack();
+    if (!pack)
+        return;
+
+    qint64 offset = pack->size();
+    if (pack->write(data) != data.size() || !pack->flush()) {
+        qDebug() << "Can't store thumbnail in" << pack->fileName() << pack->errorString();
+        return;
+    }
+
+    key = validKey(key);
+    Slot *slot = findSlot(key, level);
+    if (!slot)
+        slot = insertSlot(key, level);
+    if (!slot)
+        return;
+
+    slot->pack = m_header->currentPack;
+    slot->offset = offset;
+    slot->length = data.size();
+    slot->lastUsed = currentTime();
+}
+
+/*!
+ * \brief ThumbnailStore::move stores a thumbnail under another key, without
+ * copying its data. A thumbnail already stored under the new key becomes dead
+ * space.
+ * \param key
+ * \param newKey
+ * \param level
+ */
+void ThumbnailStore::move(quint64 key, quint64 newKey, int level)
+{
+    QWriteLocker locker(&m_lock);
+    if (!m_header)
+        return;
+
+    key = validKey(key);
+    newKey = validKey(newKey);
+    if (key == newKey)
+        return;
+
+    recordAccesses();
+
+    Slot *slot = findSlot(key, level);
+    if (!slot)
+        return;
+
+    // Inserting can rebuild the index, which moves the slots
+    Slot moved = *slot;
+    removeSlot(slot);
+
+    slot = findSlot(newKey, level);
+    if (!slot)
+        slot = insertSlot(newKey, level);
+    if (!slot)
+        return;
+
+    slot->pack = moved.pack;
+    slot->offset = moved.offset;
+    slot->length = moved.length;
+    slot->lastUsed = moved.lastUsed;
+}
+
+/*!
+ * \brief ThumbnailStore::count
+ * \return the number of stored thumbnails
+ */
+int ThumbnailStore::count()
+{
+    QReadLocker locker(&m_lock);
+    return m_header ? m_header->count : 0;
+}
+
+/*!
+ * \brief ThumbnailStore::size
+ * \return the size of all packs, including the dead space
+ */
+qint64 ThumbnailStore::size()
+{
+    QReadLocker locker(&m_lock);
+    qint64 size = 0;
+    foreach (QFile *pack, m_packs)
+        size += pack->size();
+
+    return size;
+}
+
+/*!
+ * \brief ThumbnailStore::cleanUp does one step of the clean up. The least
+ * recently used thumbnails are removed, until the others fit into the
+ * budget. Then the packs with too much dead space get compacted, by moving
+ * their thumbnails into the current pack.
+ * \param budget
+ * \return true if there are more steps to do
+ */
+bool ThumbnailStore::cleanUp(qint64 budget)
+{
+    QWriteLocker locker(&m_lock);
+    if (!m_header)
+        return false;
+
+    recordAccesses();
+    return evict(budget) || compact();
+}
+
+/*!
+ * \brief ThumbnailStore::openIndex maps the index file
+ * \return false if there is no valid index file
+ */
+bool ThumbnailStore::openIndex()
+{
+    m_indexFile.setFileName(indexFileName());
+    if (!m_indexFile.exists() || !m_indexFile.open(QIODevice::ReadWrite))
+        return false;
+
+    qint64 fileSize = m_indexFile.size();
+    if (fileSize >= qint64(sizeof(Header)))
+        m_index = m_indexFile.map(0, fileSize);
+    if (!m_index) {
+        m_indexFile.close();
+        return false;
+    }
+
+    m_header = reinterpret_cast<Header*>(m_index);
+    m_slots = reinterpret_cast<Slot*>(m_index + sizeof(Header));
+
+    quint32 capacity = m_header->capacity;
+    if (memcmp(m_header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+            m_header->format != INDEX_FORMAT || capacity == 0 ||
+            (capacity & (capacity - 1)) != 0 ||
+            fileSize != qint64(sizeof(Header) + capacity * sizeof(Slot))) {
+        qDebug() << "Invalid thumbnail index" << m_indexFile.fileName();
+        closeIndex();
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief ThumbnailStore::createIndex replaces the index file by an empty one
+ * \param capacity
+ * \param currentPack
+ * \return
+ */
+bool ThumbnailStore::createIndex(quint32 capacity, quint32 currentPack)
+{
+    closeIndex();
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.format = INDEX_FORMAT;
+    header.capacity = capacity;
+    header.currentPack = currentPack;
+
+    // The slots are all zero, so empty
+    QFile file(indexFileName() + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != qint64(sizeof(header)) ||
+            !file.resize(sizeof(Header) + capacity * sizeof(Slot))) {
+        qDebug() << "Can't create thumbnail index" << file.fileName() << file.errorString();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    QFile::remove(indexFileName());
+    if (!file.rename(indexFileName())) {
+        qDebug() << "Can't create thumbnail index" << indexFileName() << file.errorString();
+        return false;
+    }
+
+    return openIndex();
+}
+
+/*!
+ * \brief ThumbnailStore::closeIndex
+ */
+void ThumbnailStore::closeIndex()
+{
+    if (m_index)
+        m_indexFile.unmap(m_index);
+    m_indexFile.close();
+
+    m_index = 0;
+    m_header = 0;
+    m_slots = 0;
+}
+
+/*!
+ * \brief ThumbnailStore::rebuildIndex creates a new index with the stored
+ * thumbnails, big enough that it's at most half full
+ */
+void ThumbnailStore::rebuildIndex()
+{
+    QVector<Slot> slots;
+    for (quint32 i = 0; i < m_header->capacity; i++) {
+        if (m_slots[i].key > REMOVED_KEY)
+            slots.append(m_slots[i]);
+    }
+
+    quint32 capacity = MIN_CAPACITY;
+    while (capacity / 2 < quint32(slots.size()) + 1)
+        capacity *= 2;
+
+    if (!createIndex(capacity, m_header->currentPack))
+        return;
+
+    foreach (const Slot& slot, slots)
+        *insertSlot(slot.key, slot.level) = slot;
+}
+
+/*!
+ * \brief ThumbnailStore::openPacks opens all pack files of the directory
+ */
+void ThumbnailStore::openPacks()
+{
+    QStringList packs = QDir(m_directory).entryList(
+                QStringList() << PACK_FILE_PREFIX + "*" + PACK_FILE_SUFFIX, QDir::Files);
+    foreach (const QString& fileName, packs) {
+        bool ok;
+        QString number = fileName.mid(PACK_FILE_PREFIX.size(),
+                                      fileName.size() - PACK_FILE_PREFIX.size() - PACK_FILE_SUFFIX.size());
+        quint16 packNumber = number.toUShort(&ok);
+        if (!ok)
+            continue;
+
+        QFile *pack = new QFile(packFileName(packNumber));
+        if (!pack->open(QIODevice::ReadWrite | QIODevice::Append)) {
+            qDebug() << "Can't open thumbnail pack" << pack->fileName() << pack->errorString();
+            delete pack;
+            continue;
+        }
+        m_packs.insert(packNumber, pack);
+    }
+}
+
+/*!
+ * \brief ThumbnailStore::currentPack
+ * \return the pack to append to, a new one if the current one is full
+ */
+QFile *ThumbnailStore::currentPack()
+{
+    QFile *pack = m_packs.value(m_header->currentPack);
+    if (pack && pack->size() < m_maxPackSize)
+        return pack;
+
+    if (pack)
+        m_header->currentPack = quint16(m_header->currentPack + 1);
+
+    // Nothing may point into a pack that is started again
+    quint16 number = m_header->currentPack;
+    removePack(number);
+    for (quint32 i = 0; i < m_header->capacity; i++) {
+        if (m_slots[i].key > REMOVED_KEY && m_slots[i].pack == number)
+            removeSlot(m_slots + i);
+    }
+
+    pack = new QFile(packFileName(number));
+    if (!pack->open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qDebug() << "Can't create thumbnail pack" << pack->fileName() << pack->errorString();
+        delete pack;
+        return 0;
+    }
+
+    m_packs.insert(number, pack);
+    return pack;
+}
+
+/*!
+ * \brief ThumbnailStore::removePack
+ * \param number
+ */
+void ThumbnailStore::removePack(quint16 number)
+{
+    QFile *pack = m_packs.take(number);
+    if (pack) {
+        pack->remove();
+        delete pack;
+    }
+}
+
+/*!
+ * \brief ThumbnailStore::findSlot
+ * \param key
+ * \param level
+ * \return the slot of the thumbnail, 0 if it's not stored
+ */
+ThumbnailStore::Slot *ThumbnailStore::findSlot(quint64 key, int level) const
+{
+    quint32 mask = m_header->capacity - 1;
+    quint32 i = key & mask;
+    for (quint32 probes = 0; probes < m_header->capacity; probes++) {
+        Slot *slot = m_slots + i;
+        if (slot->key == EMPTY_KEY)
+            return 0;
+        if (slot->key == key && slot->level == level)
+            return slot;
+        i = (i + 1) & mask;
+    }
+
+    return 0;
+}
+
+/*!
+ * \brief ThumbnailStore::insertSlot takes a free slot for a thumbnail that
+ * is not stored yet. The index is rebuilt before it gets too full.
+ * \param key
+ * \param level
+ * \return 0 if the index could not be rebuilt
+ */
+ThumbnailStore::Slot *ThumbnailStore::insertSlot(quint64 key, int level)
+{
+    if ((m_header->count + m_header->removed + 1) * 4 > m_header->capacity * 3) {
+        rebuildIndex();
+        if (!m_header)
+            return 0;
+    }
+
+    quint32 mask = m_header->capacity - 1;
+    quint32 i = key & mask;
+    while (m_slots[i].key > REMOVED_KEY)
+        i = (i + 1) & mask;
+
+    Slot *slot = m_slots + i;
+    if (slot->key == REMOVED_KEY)
+        m_header->removed--;
+    m_header->count++;
+
+    memset(slot, 0, sizeof(Slot));
+    slot->key = key;
+    slot->level = level;
+    return slot;
+}
+
+/*!
+ * \brief ThumbnailStore::removeSlot
+ * \param slot
+ */
+void ThumbnailStore::removeSlot(Slot *slot)
+{
+    slot->key = REMOVED_KEY;
+    m_header->count--;
+    m_header->removed++;
+}
+
+/*!
+ * \brief ThumbnailStore::recordAccesses writes the last uses of the found
+ * thumbnails into their slots. The write lock has to be held.
+ */
+void ThumbnailStore::recordAccesses()
+{
+    QHash<QPair<quint64, int>, quint32> accesses;
+    {
+        QMutexLocker locker(&m_accessesMutex);
+        accesses.swap(m_accesses);
+    }
+
+    QHashIterator<QPair<quint64, int>, quint32> i(accesses);
+    while (i.hasNext()) {
+        i.next();
+        Slot *slot = findSlot(i.key().first, i.key().second);
+        if (slot)
+            slot->lastUsed = i.value();
+    }
+}
+
+/*!
+ * \brief lessRecentlyUsed
+ * \return true if the slot a was used before the slot b
+ */
+template<typename T>
+static bool lessRecentlyUsed(const T *a, const T *b)
+{
+    return a->lastUsed < b->lastUsed;
+}
+
+/*!
+ * \brief ThumbnailStore::evict removes some of the least recently used
+ * thumbnails from the index, if the stored ones don't fit into the budget
+ * \param budget
+ * \return true if thumbnails were removed
+ */
+bool ThumbnailStore::evict(qint64 budget)
+{
+    qint64 liveBytes = 0;
+    QVector<Slot*> slots;
+    for (quint32 i = 0; i < m_header->capacity; i++) {
+        if (m_slots[i].key > REMOVED_KEY) {
+            liveBytes += m_slots[i].length;
+            slots.append(m_slots + i);
+        }
+    }
+
+    if (liveBytes <= budget)
+        return false;
+
+    // Only a batch per step, so finding thumbnails isn't blocked for long
+    int batch = qMin(slots.size(), EVICTION_BATCH);
+    std::partial_sort(slots.begin(), slots.begin() + batch, slots.end(), lessRecentlyUsed<Slot>);
+    for (int i = 0; i < batch && liveBytes > budget; i++) {
+        liveBytes -= slots[i]->length;
+        removeSlot(slots[i]);
+    }
+
+    return true;
+}
+
+/*!
+ * \brief ThumbnailStore::compact removes a pack without thumbnails, or moves
+ * some thumbnails out of a pack that is mostly dead space
+ * \return true if something was done
+ */
+bool ThumbnailStore::compact()
+{
+    QMap<quint16, qint64> liveBytes;
+    for (quint32 i = 0; i < m_header->capacity; i++) {
+        if (m_slots[i].key > REMOVED_KEY)
+            liveBytes[m_slots[i].pack] += m_slots[i].length;
+    }
+
+    QFile *pack = 0;
+    quint16 number = 0;
+    foreach (quint16 packNumber, m_packs.keys()) {
+        if (packNumber == m_header->currentPack)
+            continue;
+
+        qint64 live = liveBytes.value(packNumber);
+        if (live == 0) {
+            removePack(packNumber);
+            return true;
+        }
+
+        qint64 size = m_packs[packNumber]->size();
+        if ((size - live) * 100 > size * COMPACTION_THRESHOLD) {
+            pack = m_packs[packNumber];
+            number = packNumber;
+            break;
+        }
+    }
+
+    if (!pack)
+        return false;
+
+    int moved = 0;
+    for (quint32 i = 0; i < m_header->capacity && moved < COMPACTION_BATCH; i++) {
+        Slot *slot = m_slots + i;
+        if (slot->key <= REMOVED_KEY || slot->pack != number)
+            continue;
+
+        QByteArray data(slot->length, Qt::Uninitialized);
+        if (::pread(pack->handle(), data.data(), slot->length, slot->offset) != ssize_t(slot->length)) {
+            removeSlot(slot);
+            continue;
+        }
+
+        QFile *current = currentPack();
+        if (!current)
+            return false;
+
+        qint64 offset = current->size();
+        if (current->write(data) != data.size() || !current->flush())
+            return false;
+
+        slot->pack = m_header->currentPack;
+        slot->offset = offset;
+        moved++;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief ThumbnailStore::indexFileName
+ * \return
+ */
+QString ThumbnailStore::indexFileName() const
+{
+    return m_directory + QDir::separator() + INDEX_FILE_NAME;
+}
+
+/*!
+ * \brief ThumbnailStore::packFileName
+ * \param number
+ * \return
+ */
+QString ThumbnailStore::packFileName(quint16 number) const
+{
+    return m_directory + QDir::separator() + PACK_FILE_PREFIX + QString::number(number) +
+            PACK_FILE_SUFFIX;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2013 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GALLERY_THUMBNAIL_STORE_H_
+#define GALLERY_THUMBNAIL_STORE_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QReadWriteLock>
+#include <QString>
+
+/*!
+ * \brief The ThumbnailStore class keeps the encoded thumbnails in a few big
+ * pack files, that only get appended to.
+ * Where each thumbnail is, is stored in a hash table in a memory mapped index
+ * file, so finding a thumbnail needs no system call, and reading it needs a
+ * single pread().
+ * Replaced and evicted thumbnails stay in their pack as dead space, until the
+ * pack is compacted by cleanUp().
+ */
+class ThumbnailStore
+{
+public:
+    explicit ThumbnailStore(const QString& directory);
+    ~ThumbnailStore();
+
+    QByteArray find(quint64 key, int level);
+    void insert(quint64 key, int level, const QByteArray& data);
+    void move(quint64 key, quint64 newKey, int level);
+
+    int count();
+    qint64 size();
+
+    bool cleanUp(qint64 budget);
+
+private:
+    struct Header;
+    struct Slot;
+
+    bool openIndex();
+    bool createIndex(quint32 capacity, quint32 currentPack);
+    void closeIndex();
+    void rebuildIndex();
+    void openPacks();
+    QFile *currentPack();
+    void removePack(quint16 number);
+
+    Slot *findSlot(quint64 key, int level) const;
+    Slot *insertSlot(quint64 key, int level);
+    void removeSlot(Slot *slot);
+    void recordAccesses();
+
+    bool evict(qint64 budget);
+    bool compact();
+
+    QString indexFileName() const;
+    QString packFileName(quint16 number) const;
+
+    QString m_directory;
+    QFile m_indexFile;
+    uchar *m_index;
+    Header *m_header;
+    Slot *m_slots;
+    QMap<quint16, QFile*> m_packs;
+    qint64 m_maxPackSize;
+    QReadWriteLock m_lock;
+    // Last uses of the thumbnails found under the read lock, by key and
+    // level. They get into the slots under the write lock.
+    QHash<QPair<quint64, int>, quint32> m_accesses;
+    QMutex m_accessesMutex;
+
+    friend class tst_ThumbnailCache;
+};
+
+#endif // GALLERY_THUMBNAIL_STORE_H_
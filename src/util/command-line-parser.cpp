@@ -35,6 +35,7 @@ CommandLineParser::CommandLineParser(const QHash<QString, QSize>& form_factors)
       m_picturesDir(""),
       m_pickMode(false),
       m_logImageLoading(false),
+      m_slowQueryTime(-1),
       m_formFactors(form_factors),
       m_formFactor("desktop"),
       m_mediaFile("")
@@ -74,6 +75,19 @@ bool CommandLineParser::processArguments(const QStringList& args)
         else if (args[i] == "--log-image-loading") {
             m_logImageLoading = true;
         }
+        else if (args[i] == "--log-sql") {
+            bool ok = false;
+            int slowQueryTime = value.toInt(&ok);
+            if (ok && slowQueryTime >= 0) {
+                m_slowQueryTime = slowQueryTime;
+                i++;
+            }
+            else {
+                QTextStream(stderr) << "Missing MSECS argument for --log-sql" << endl;
+                usage();
+                valid_args = false;
+            }
+        }
         else if (args[i] == "--pick-mode") {
             m_pickMode = true;
         }
@@ -138,6 +152,7 @@ void CommandLineParser::usage()
 
     out << "  --startup-timer\n\t\tdebug-print startup time" << endl;
     out << "  --log-image-loading\n\t\tlog image loading" << endl;
+    out << "  --log-sql MSECS\n\t\tprint SQL statistics at exit, and log queries slower than MSECS" << endl;
     out << "  --pick-mode\n\t\tEnable mode to pick photos" << endl;
     out << "  --media-file FILE\n\t\tOpens gallery displaying the selected file" << endl;
     out << "pictures_dir defaults to ~/Pictures, and must exist prior to running gallery" << endl;
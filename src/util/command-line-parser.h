@@ -43,6 +43,7 @@ public:
     bool isFullscreen() const { return m_isFullscreen; }
     bool startupTimer() const { return m_startupTimer; }
     bool logImageLoading() const { return m_logImageLoading; }
+    int slowQueryTime() const { return m_slowQueryTime; }
     bool pickModeEnabled() const { return m_pickMode; }
     const QString &formFactor() const { return m_formFactor; }
     const QString &mediaFile() const { return m_mediaFile; }
@@ -58,6 +59,7 @@ private:
     QString m_picturesDir;
     bool m_pickMode;
     bool m_logImageLoading;
+    int m_slowQueryTime;
 
     const QHash<QString, QSize> m_formFactors;
     QString m_formFactor;
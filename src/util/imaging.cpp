@@ -19,10 +19,193 @@
 
 
 #include <QApplication>
+#include <QTransform>
+#include <QVector>
 #include <qmath.h>
 
 #include "imaging.h"
 
+// Fractional bits of the weights of the source pixels in scaleAndOrient()
+static const int WEIGHT_BITS = 14;
+// Fractional bits kept of the channels of a horizontally scaled row
+static const int ROW_BITS = 8;
+
+/*!
+ * \brief The ScaleSpan struct holds which source pixels make up one pixel of
+ * the scaled image, and the index of their first weight
+ */
+struct ScaleSpan
+{
+    int first;
+    int count;
+    int weights;
+};
+
+/*!
+ * \brief scaleSpans computes the box filter for scaling a row or column down
+ * \param sourceLength
+ * \param length at most sourceLength
+ * \param spans gets one span for each scaled pixel
+ * \param weights gets the weights of all spans, each span's adding up to
+ * 1 << WEIGHT_BITS
+ */
+static void scaleSpans(int sourceLength, int length,
+                       QVector<ScaleSpan>& spans, QVector<int>& weights)
+{
+    spans.resize(length);
+    weights.clear();
+    weights.reserve(sourceLength + length);
+
+    // In units of 1 / length source pixels, scaled pixel i covers
+    // [i * sourceLength, (i + 1) * sourceLength) and source pixel j covers
+    // [j * length, (j + 1) * length)
+    for (int i = 0; i < length; i++) {
+        qint64 begin = qint64(i) * sourceLength;
+        qint64 end = begin + sourceLength;
+
+        ScaleSpan& span = spans[i];
+        span.first = begin / length;
+        span.count = 0;
+        span.weights = weights.count();
+
+        int total = 0;
+        for (int j = span.first; qint64(j) * length < end; j++) {
+            qint64 overlap = qMin(end, qint64(j + 1) * length) - qMax(begin, qint64(j) * length);
+            int weight = (overlap << WEIGHT_BITS) / sourceLength;
+            weights.append(weight);
+            total += weight;
+            span.count++;
+        }
+        weights.last() += (1 << WEIGHT_BITS) - total;
+    }
+}
+
+/*!
+ * \brief scaleRow scales one row of pixels down horizontally
+ * \param line the source pixels
+ * \param spans
+ * \param weights
+ * \param row gets 4 channels for each scaled pixel, with ROW_BITS fractional
+ * bits each
+ */
+static void scaleRow(const QRgb *line, const QVector<ScaleSpan>& spans,
+                     const QVector<int>& weights, quint32 *row)
+{
+    const int *weightData = weights.constData();
+    const int rounding = 1 << (WEIGHT_BITS - ROW_BITS - 1);
+
+    for (int x = 0; x < spans.count(); x++) {
+        const ScaleSpan& span = spans.at(x);
+        const QRgb *pixel = line + span.first;
+        const int *weight = weightData + span.weights;
+
+        quint32 b = 0, g = 0, r = 0, a = 0;
+        for (int k = 0; k < span.count; k++) {
+            QRgb p = pixel[k];
+            quint32 w = weight[k];
+            b += (p & 0xff) * w;
+            g += ((p >> 8) & 0xff) * w;
+            r += ((p >> 16) & 0xff) * w;
+            a += (p >> 24) * w;
+        }
+
+        row[4 * x] = (b + rounding) >> (WEIGHT_BITS - ROW_BITS);
+        row[4 * x + 1] = (g + rounding) >> (WEIGHT_BITS - ROW_BITS);
+        row[4 * x + 2] = (r + rounding) >> (WEIGHT_BITS - ROW_BITS);
+        row[4 * x + 3] = (a + rounding) >> (WEIGHT_BITS - ROW_BITS);
+    }
+}
+
+/*!
+ * \brief scaleAndOrient scales an image down with a box filter and applies an
+ * orientation to it in one pass, without the intermediate full size images of
+ * QImage::scaled() followed by QImage::transformed().
+ * Each source row is scaled horizontally once, the scaled rows are summed up
+ * per scaled row, and each finished row is written straight to its rotated or
+ * flipped place in the result.
+ * \param image
+ * \param size the image is scaled to, before it gets oriented. It's bounded
+ * to the size of the image, as the image is never scaled up
+ * \param orientation
+ * \return the image in the format RGB32, or ARGB32_Premultiplied if it has an
+ * alpha channel
+ */
+QImage scaleAndOrient(const QImage& image, const QSize& size, Orientation orientation)
+{
+    QSize scaledSize = size.boundedTo(image.size());
+    if (image.isNull() || scaledSize.isEmpty())
+        return QImage();
+    if (scaledSize == image.size() && orientation == TOP_LEFT_ORIGIN)
+        return image;
+
+    QImage::Format format = image.hasAlphaChannel() ?
+                QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    QImage source = image.convertToFormat(format);
+
+    int width = scaledSize.width();
+    int height = scaledSize.height();
+    QTransform transform = QImage::trueMatrix(
+                OrientationCorrection::fromOrientation(orientation).toTransform(),
+                width, height);
+    QImage result(transform.mapRect(QRect(0, 0, width, height)).size(), format);
+    if (result.isNull())
+        return result;
+
+    // Where the pixels of the scaled image go in the result, in pixels
+    int stride = result.bytesPerLine() / sizeof(QRgb);
+    QPointF origin = transform.map(QPointF(0.5, 0.5));
+    QPointF stepX = transform.map(QPointF(1.5, 0.5)) - origin;
+    QPointF stepY = transform.map(QPointF(0.5, 1.5)) - origin;
+    int originOffset = qFloor(origin.y()) * stride + qFloor(origin.x());
+    int stepXOffset = qRound(stepX.y()) * stride + qRound(stepX.x());
+    int stepYOffset = qRound(stepY.y()) * stride + qRound(stepY.x());
+
+    QVector<ScaleSpan> columns, rows;
+    QVector<int> columnWeights, rowWeights;
+    scaleSpans(source.width(), width, columns, columnWeights);
+    scaleSpans(source.height(), height, rows, rowWeights);
+
+    QVector<quint32> row(4 * width);
+    QVector<quint32> sum(4 * width);
+    quint32 *rowData = row.data();
+    quint32 *sumData = sum.data();
+    int scaledRow = -1;
+
+    QRgb *resultData = reinterpret_cast<QRgb*>(result.bits());
+    const int rounding = 1 << (WEIGHT_BITS + ROW_BITS - 1);
+
+    for (int y = 0; y < height; y++) {
+        const ScaleSpan& span = rows.at(y);
+        sum.fill(0);
+
+        for (int k = 0; k < span.count; k++) {
+            int j = span.first + k;
+            // Neighbouring scaled rows share their boundary source row
+            if (j != scaledRow) {
+                scaleRow(reinterpret_cast<const QRgb*>(source.constScanLine(j)),
+                         columns, columnWeights, rowData);
+                scaledRow = j;
+            }
+
+            quint32 w = rowWeights.at(span.weights + k);
+            for (int i = 0; i < 4 * width; i++)
+                sumData[i] += rowData[i] * w;
+        }
+
+        QRgb *target = resultData + originOffset + y * stepYOffset;
+        for (int x = 0; x < width; x++) {
+            const quint32 *channels = sumData + 4 * x;
+            target[x * stepXOffset] =
+                    ((channels[3] + rounding) >> (WEIGHT_BITS + ROW_BITS)) << 24 |
+                    ((channels[2] + rounding) >> (WEIGHT_BITS + ROW_BITS)) << 16 |
+                    ((channels[1] + rounding) >> (WEIGHT_BITS + ROW_BITS)) << 8 |
+                    ((channels[0] + rounding) >> (WEIGHT_BITS + ROW_BITS));
+        }
+    }
+
+    return result;
+}
+
 /*!
  * \brief HSVTransformation::transformPixel
  * \param pixel_color
@@ -44,13 +227,20 @@ QColor HSVTransformation::transformPixel(const QColor &pixel_color) const
 
 /*!
  * \brief IntensityHistogram::IntensityHistogram
- * \param basis_image
  */
-IntensityHistogram::IntensityHistogram(const QImage& basis_image)
+IntensityHistogram::IntensityHistogram()
 {
     for (int i = 0; i < 256; i++)
         m_counts[i] = 0;
+}
 
+/*!
+ * \brief IntensityHistogram::IntensityHistogram
+ * \param basis_image
+ */
+IntensityHistogram::IntensityHistogram(const QImage& basis_image)
+    : IntensityHistogram()
+{
     int width = basis_image.width();
     int height = basis_image.height();
 
@@ -64,10 +254,21 @@ IntensityHistogram::IntensityHistogram(const QImage& basis_image)
         }
     }
 
-    float pixel_count = (float)(width * height);
+    computeProbabilities();
+}
+
+/*!
+ * \brief IntensityHistogram::computeProbabilities
+ */
+void IntensityHistogram::computeProbabilities()
+{
+    float pixel_count = 0.0f;
+    for (int i = 0; i < 256; i++)
+        pixel_count += m_counts[i];
+
     float accumulator = 0.0f;
     for (int i = 0; i < 256; i++) {
-        m_probabilities[i] = ((float) m_counts[i]) / pixel_count;
+        m_probabilities[i] = (pixel_count > 0.0f) ? ((float) m_counts[i]) / pixel_count : 0.0f;
         accumulator += m_probabilities[i];
         m_cumulativeProbabilities[i] = accumulator;
     }
@@ -83,6 +284,21 @@ float IntensityHistogram::getCumulativeProbability(int level)
     return m_cumulativeProbabilities[level];
 }
 
+/*!
+ * \brief IntensityHistogram::remapped
+ * \param transformation
+ * \return the histogram of the image after the transformation. That changes
+ * only the intensity of each pixel, so it needs no pass over the image.
+ */
+IntensityHistogram IntensityHistogram::remapped(const HSVTransformation& transformation) const
+{
+    IntensityHistogram result;
+    for (int i = 0; i < 256; i++)
+        result.m_counts[transformation.remapIntensity(i)] += m_counts[i];
+    result.computeProbabilities();
+
+    return result;
+}
 
 const float ToneExpansionTransformation::DEFAULT_LOW_DISCARD_MASS = 0.02f;
 const float ToneExpansionTransformation::DEFAULT_HIGH_DISCARD_MASS = 0.98f;
@@ -250,9 +466,19 @@ const float AutoEnhanceTransformation::SHADOW_AGGRESSIVENESS_MUL = 0.45f;
  * \param basis
  */
 AutoEnhanceTransformation::AutoEnhanceTransformation(const QImage& basis)
+    : AutoEnhanceTransformation(IntensityHistogram(basis))
+{
+}
+
+/*!
+ * \brief AutoEnhanceTransformation::AutoEnhanceTransformation chooses the
+ * curves from the intensity histogram of the image alone
+ * \param basis_histogram
+ */
+AutoEnhanceTransformation::AutoEnhanceTransformation(const IntensityHistogram& basis_histogram)
     : m_shadowTransform(0), m_toneExpansionTransform(0)
 {
-    IntensityHistogram histogram = IntensityHistogram(basis);
+    IntensityHistogram histogram = basis_histogram;
 
     /* compute the percentage of pixels in the image that fall into the
      shadow range -- this measures "of the pixels in the image, how many of
@@ -289,28 +515,12 @@ AutoEnhanceTransformation::AutoEnhanceTransformation(const QImage& basis)
         m_shadowTransform
                 = new ShadowDetailTransformation(shadow_trans_effect_size);
 
-        QImage shadow_corrected_image = QImage(basis);
-        // Can't write into indexed images, due to a limitation in Qt.
-        if (shadow_corrected_image.format() == QImage::Format_Indexed8)
-            shadow_corrected_image = shadow_corrected_image.convertToFormat(
-                        QImage::Format_RGB32);
-
-        for (int j = 0; j < shadow_corrected_image.height(); j++) {
-            QApplication::processEvents();
-
-            for (int i = 0; i < shadow_corrected_image.width(); i++) {
-                QColor px = m_shadowTransform->transformPixel(
-                            QColor(shadow_corrected_image.pixel(i, j)));
-                shadow_corrected_image.setPixel(i, j, px.rgb());
-            }
-        }
-
+        // The histogram of the shadow corrected image
         m_toneExpansionTransform = new ToneExpansionTransformation(
-                    IntensityHistogram(shadow_corrected_image), 0.005f, 0.995f);
+                    histogram.remapped(*m_shadowTransform), 0.005f, 0.995f);
 
     } else {
-        m_toneExpansionTransform = new ToneExpansionTransformation(
-                    IntensityHistogram(basis));
+        m_toneExpansionTransform = new ToneExpansionTransformation(histogram);
     }
 }
 
@@ -24,6 +24,8 @@
 #include <QImage>
 #include <QVector4D>
 
+#include "orientation.h"
+
 /*!
  * \brief clampi
  * \param i
@@ -46,6 +48,8 @@ inline float clampf(float x, float min, float max) {
     return (x < min) ? min : ((x > max) ? max : x);
 }
 
+QImage scaleAndOrient(const QImage& image, const QSize& size, Orientation orientation);
+
 /*!
  * \brief The HSVTransformation class
  */
@@ -58,6 +62,8 @@ public:
     virtual QColor transformPixel(const QColor& pixel_color) const;
     virtual bool isIdentity() const = 0;
 
+    int remapIntensity(int intensity) const { return remap_table_[intensity]; }
+
 protected:
     int remap_table_[256];
 };
@@ -73,7 +79,12 @@ public:
 
     float getCumulativeProbability(int level);
 
+    IntensityHistogram remapped(const HSVTransformation& transformation) const;
+
 private:
+    IntensityHistogram();
+    void computeProbabilities();
+
     int m_counts[256];
     float m_probabilities[256];
     float m_cumulativeProbabilities[256];
@@ -154,6 +165,7 @@ class AutoEnhanceTransformation : public virtual HSVTransformation
 
 public:
     AutoEnhanceTransformation(const QImage& basis_image);
+    AutoEnhanceTransformation(const IntensityHistogram& histogram);
     virtual ~AutoEnhanceTransformation();
 
     QColor transformPixel(const QColor& pixel_color) const;
@@ -37,6 +37,7 @@ private slots:
     void is_fullscreen_test();
     void startup_timer_test();
     void log_image_loading_test();
+    void slow_query_time_test();
 
     void process_args_test();
     void process_args_test_data();
@@ -80,6 +81,13 @@ void tst_CommandLineParser::log_image_loading_test()
     QCOMPARE(cmd_line_parser_->logImageLoading(), expect);
 }
 
+void tst_CommandLineParser::slow_query_time_test()
+{
+    int expect = -1;
+
+    QCOMPARE(cmd_line_parser_->slowQueryTime(), expect);
+}
+
 void tst_CommandLineParser::process_args_test_data()
 {
     QTest::addColumn<QStringList>("process_args");
@@ -88,6 +96,7 @@ void tst_CommandLineParser::process_args_test_data()
     QTest::addColumn<bool>("startup_timer");
     QTest::addColumn<bool>("log_image_loading");
     QTest::addColumn<bool>("pick_mode_enabled");
+    QTest::addColumn<int>("slow_query_time");
     QTest::addColumn<bool>("invalid_arg");
 
     QStringList boolean_test;
@@ -102,17 +111,30 @@ void tst_CommandLineParser::process_args_test_data()
     invalid_arg_test.append("gallery");
     invalid_arg_test.append("rAnD0m");
 
+    QStringList log_sql_test;
+    log_sql_test.append("gallery");
+    log_sql_test.append("--log-sql");
+    log_sql_test.append("100");
+
+    QStringList log_sql_missing_test;
+    log_sql_missing_test.append("gallery");
+    log_sql_missing_test.append("--log-sql");
+
     QStringList help_test;
     help_test.append("gallery");
     help_test.append("-h");
     help_test.append("--landscape");
 
     QTest::newRow("Boolean member test") << boolean_test << true << true << true << true
-                                         << true << true;
+                                         << true << -1 << true;
     QTest::newRow("Invalid arg test") << invalid_arg_test << false << false << false << false
-                                      << false << false;
+                                      << false << -1 << false;
+    QTest::newRow("Log SQL test") << log_sql_test << false << false << false << false
+                                  << false << 100 << true;
+    QTest::newRow("Log SQL missing time test") << log_sql_missing_test << false << false << false
+                                               << false << false << -1 << false;
     QTest::newRow("Help test") << help_test << false << false << false << false
-                               << false << false;
+                               << false << -1 << false;
 }
 
 void tst_CommandLineParser::process_args_test()
@@ -127,6 +149,7 @@ void tst_CommandLineParser::process_args_test()
     QFETCH(bool, startup_timer);
     QFETCH(bool, log_image_loading);
     QFETCH(bool, pick_mode_enabled);
+    QFETCH(int, slow_query_time);
     QFETCH(bool, invalid_arg);
 
     bool result = test.processArguments(process_args);
@@ -136,6 +159,7 @@ void tst_CommandLineParser::process_args_test()
     QCOMPARE(test.startupTimer(), startup_timer);
     QCOMPARE(test.logImageLoading(), log_image_loading);
     QCOMPARE(test.pickModeEnabled(), pick_mode_enabled);
+    QCOMPARE(test.slowQueryTime(), slow_query_time);
     QCOMPARE(result, invalid_arg);
 }
 
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2013 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+#include "database.h"
+#include "database-writer.h"
+#include "media-table.h"
+#include "resource.h"
+
+class tst_Database : public QObject
+{
+  Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void migrationMediaType();
+    void mediaOfDay();
+    void mediaPage();
+
+private:
+    bool createDatabase(int version);
+    bool insertMedia(qint64 id, const QString& basename, const QDateTime& exposureTime);
+
+    QTemporaryDir *m_dir;
+    Resource *m_resource;
+};
+
+void tst_Database::init()
+{
+    m_dir = new QTemporaryDir;
+    m_resource = new Resource(false, m_dir->path());
+}
+
+void tst_Database::cleanup()
+{
+    delete m_resource;
+    m_resource = 0;
+    delete m_dir;
+    m_dir = 0;
+}
+
+/*!
+ * \brief tst_Database::createDatabase creates the database of an older
+ * version, which the Database upgrades when opening it
+ * \param version the last schema file applied
+ * \return
+ */
+bool tst_Database::createDatabase(int version)
+{
+    if (!QDir().mkpath(m_resource->databaseDirectory()))
+        return false;
+
+    bool ok;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "fixture");
+        db.setDatabaseName(m_resource->databaseDirectory() + "/gallery.sqlite");
+        ok = db.open();
+
+        QString sqlDir = Resource::getRcUrl("sql").path();
+        for (int i = 1; ok && i <= version; i++) {
+            QFile file(sqlDir + "/" + QString::number(i) + ".sql");
+            if (!file.open(QIODevice::ReadOnly)) {
+                ok = false;
+                break;
+            }
+
+            // One statement at a time, like the Database does
+            QStringList statements = QString(file.readAll()).split(";", QString::SkipEmptyParts);
+            foreach (const QString& statement, statements) {
+                if (statement.trimmed().isEmpty())
+                    continue;
+
+                QSqlQuery query(db);
+                if (!query.exec(statement)) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        QSqlQuery query(db);
+        ok = ok && query.exec("PRAGMA user_version = " + QString::number(version));
+        ok = ok && query.exec("INSERT INTO DirectoryTable (id, path) VALUES (1, '/media/')");
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("fixture");
+
+    return ok;
+}
+
+/*!
+ * \brief tst_Database::insertMedia adds a row to the database created by
+ * createDatabase()
+ * \param id
+ * \param basename
+ * \param exposureTime
+ * \return
+ */
+bool tst_Database::insertMedia(qint64 id, const QString& basename, const QDateTime& exposureTime)
+{
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "fixture");
+        db.setDatabaseName(m_resource->databaseDirectory() + "/gallery.sqlite");
+        if (db.open()) {
+            QSqlQuery query(db);
+            query.prepare("INSERT INTO MediaTable (id, dir_id, basename, exposure_time) "
+                          "VALUES (:id, 1, :basename, :exposure_time)");
+            query.bindValue(":id", id);
+            query.bindValue(":basename", basename);
+            query.bindValue(":exposure_time", exposureTime.toMSecsSinceEpoch());
+            ok = query.exec();
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase("fixture");
+
+    return ok;
+}
+
+void tst_Database::migrationMediaType()
+{
+    QDateTime exposureTime(QDate(2013, 5, 1), QTime(10, 0));
+    QVERIFY(createDatabase(10));
+    QVERIFY(insertMedia(1, "photo.jpg", exposureTime));
+    QVERIFY(insertMedia(2, "clip.MP4", exposureTime));
+    QVERIFY(insertMedia(3, "movie.mkv", exposureTime));
+    QVERIFY(insertMedia(4, "mp4.png", exposureTime));
+
+    Database db(m_resource);
+
+    QSqlQuery query = db.prepare("SELECT id, media_type FROM MediaTable ORDER BY id");
+    QVERIFY(db.exec(query));
+    QHash<qint64, int> mediaTypes;
+    while (db.next(query))
+        mediaTypes.insert(query.value(0).toLongLong(), query.value(1).toInt());
+    query.finish();
+
+    QCOMPARE(mediaTypes.count(), 4);
+    QCOMPARE(mediaTypes.value(1), int(MediaSource::Photo));
+    QCOMPARE(mediaTypes.value(2), int(MediaSource::Video));
+    QCOMPARE(mediaTypes.value(3), int(MediaSource::Video));
+    QCOMPARE(mediaTypes.value(4), int(MediaSource::Photo));
+}
+
+void tst_Database::mediaOfDay()
+{
+    QDate day(2013, 5, 1);
+    QVERIFY(createDatabase(10));
+    QVERIFY(insertMedia(1, "morning.jpg", QDateTime(day, QTime(8, 0))));
+    QVERIFY(insertMedia(2, "noon.mp4", QDateTime(day, QTime(12, 0))));
+    QVERIFY(insertMedia(3, "evening.jpg", QDateTime(day, QTime(23, 59))));
+    QVERIFY(insertMedia(4, "midnight.mp4", QDateTime(day.addDays(1), QTime(0, 0))));
+    QVERIFY(insertMedia(5, "yesterday.jpg", QDateTime(day.addDays(-1), QTime(12, 0))));
+
+    Database db(m_resource);
+    MediaTable *mediaTable = db.getMediaTable();
+
+    // The newest first
+    QCOMPARE(mediaTable->getMediaOfDay(MediaSource::None, day),
+             QList<qint64>() << 3 << 2 << 1);
+    QCOMPARE(mediaTable->getMediaOfDay(MediaSource::Photo, day),
+             QList<qint64>() << 3 << 1);
+    QCOMPARE(mediaTable->getMediaOfDay(MediaSource::Video, day),
+             QList<qint64>() << 2);
+    QCOMPARE(mediaTable->getMediaOfDay(MediaSource::Video, day.addDays(1)),
+             QList<qint64>() << 4);
+    QCOMPARE(mediaTable->getMediaOfDay(MediaSource::Video, day.addDays(2)),
+             QList<qint64>());
+
+    // Removals are written in the background
+    mediaTable->remove(2);
+    qint64 id = mediaTable->createIdForMedia("/media/later.mp4", QDateTime(),
+                                             QDateTime(day, QTime(18, 0)),
+                                             TOP_LEFT_ORIGIN, 0, QSize(),
+                                             MediaSource::Video);
+    db.getWriter()->flush();
+    QCOMPARE(mediaTable->getMediaOfDay(MediaSource::Video, day),
+             QList<qint64>() << id);
+}
+
+void tst_Database::mediaPage()
+{
+    QDate day(2013, 5, 1);
+    QVERIFY(createDatabase(10));
+    QVERIFY(insertMedia(1, "first.jpg", QDateTime(day, QTime(8, 0))));
+    QVERIFY(insertMedia(2, "second.mp4", QDateTime(day, QTime(9, 0))));
+    QVERIFY(insertMedia(3, "third.jpg", QDateTime(day, QTime(10, 0))));
+    QVERIFY(insertMedia(4, "fourth.jpg", QDateTime(day, QTime(10, 0))));
+    QVERIFY(insertMedia(5, "fifth.mp4", QDateTime(day.addDays(1), QTime(8, 0))));
+
+    Database db(m_resource);
+    MediaTable *mediaTable = db.getMediaTable();
+
+    // The newest first, the same time ordered by ID
+    QCOMPARE(mediaTable->getMediaPage(MediaSource::None, 0, 2),
+             QList<qint64>() << 5 << 4);
+    QCOMPARE(mediaTable->getMediaPage(MediaSource::None, 2, 2),
+             QList<qint64>() << 3 << 2);
+    QCOMPARE(mediaTable->getMediaPage(MediaSource::None, 4, 2),
+             QList<qint64>() << 1);
+    QCOMPARE(mediaTable->getMediaPage(MediaSource::None, 6, 2),
+             QList<qint64>());
+
+    QCOMPARE(mediaTable->getMediaPage(MediaSource::Photo, 0, 2),
+             QList<qint64>() << 4 << 3);
+    QCOMPARE(mediaTable->getMediaPage(MediaSource::Photo, 2, 2),
+             QList<qint64>() << 1);
+    QCOMPARE(mediaTable->getMediaPage(MediaSource::Video, 0, 10),
+             QList<qint64>() << 5 << 2);
+}
+
+QTEST_MAIN(tst_Database);
+
+#include "tst_database.moc"
@@ -26,6 +26,10 @@ class tst_Imaging : public QObject
 private slots:
     void transform_pixel_data();
     void transform_pixel();
+    void scale_and_orient_data();
+    void scale_and_orient();
+    void scale_down();
+    void histogram_remapped();
 };
 
 
@@ -63,6 +67,85 @@ void tst_Imaging::transform_pixel()
     QCOMPARE(cb.transformPixel(color), result);
 }
 
+void tst_Imaging::scale_and_orient_data()
+{
+    QTest::addColumn<int>("orientation");
+
+    for (int o = MIN_ORIENTATION; o <= MAX_ORIENTATION; o++)
+        QTest::newRow(QByteArray::number(o).constData()) << o;
+}
+
+void tst_Imaging::scale_and_orient()
+{
+    QFETCH(int, orientation);
+
+    QImage image(3, 2, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); y++) {
+        for (int x = 0; x < image.width(); x++)
+            image.setPixel(x, y, qRgb(40 * x, 100 * y, 10));
+    }
+
+    QImage expected = image.transformed(OrientationCorrection::fromOrientation(
+                                            (Orientation)orientation).toTransform());
+    QImage result = scaleAndOrient(image, image.size(), (Orientation)orientation);
+    QCOMPARE(result.convertToFormat(QImage::Format_RGB32),
+             expected.convertToFormat(QImage::Format_RGB32));
+}
+
+void tst_Imaging::scale_down()
+{
+    QImage image(3, 1, QImage::Format_RGB32);
+    image.setPixel(0, 0, qRgb(0, 0, 0));
+    image.setPixel(1, 0, qRgb(90, 90, 90));
+    image.setPixel(2, 0, qRgb(180, 180, 180));
+
+    // Each scaled pixel covers one and a half source pixels
+    QImage result = scaleAndOrient(image, QSize(2, 1), TOP_LEFT_ORIGIN);
+    QCOMPARE(result.size(), QSize(2, 1));
+    QCOMPARE(result.pixel(0, 0), qRgb(30, 30, 30));
+    QCOMPARE(result.pixel(1, 0), qRgb(150, 150, 150));
+
+    // Rotated by 90 degrees
+    result = scaleAndOrient(image, QSize(2, 1), RIGHT_TOP_ORIGIN);
+    QCOMPARE(result.size(), QSize(1, 2));
+    QCOMPARE(result.pixel(0, 0), qRgb(30, 30, 30));
+    QCOMPARE(result.pixel(0, 1), qRgb(150, 150, 150));
+
+    // Never scaled up
+    result = scaleAndOrient(image, QSize(6, 2), TOP_LEFT_ORIGIN);
+    QCOMPARE(result.size(), QSize(3, 1));
+}
+
+// Mostly dark, so auto enhance brings out the shadows
+static QImage shadow_image()
+{
+    QImage image(64, 64, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); y++) {
+        for (int x = 0; x < image.width(); x++) {
+            int v = (x < 48) ? (x + y) % 80 : 120 + (x * y) % 136;
+            image.setPixel(x, y, qRgb(v, v / 2, v / 3));
+        }
+    }
+    return image;
+}
+
+void tst_Imaging::histogram_remapped()
+{
+    QImage image = shadow_image();
+    ShadowDetailTransformation shadow(0.3f);
+
+    QImage corrected(image);
+    for (int y = 0; y < corrected.height(); y++) {
+        for (int x = 0; x < corrected.width(); x++)
+            corrected.setPixel(x, y, shadow.transformPixel(QColor(corrected.pixel(x, y))).rgb());
+    }
+
+    IntensityHistogram expected(corrected);
+    IntensityHistogram remapped = IntensityHistogram(image).remapped(shadow);
+    for (int i = 0; i < 256; i++)
+        QCOMPARE(remapped.getCumulativeProbability(i), expected.getCumulativeProbability(i));
+}
+
 QTEST_MAIN(tst_Imaging);
 
 #include "tst_imaging.moc"
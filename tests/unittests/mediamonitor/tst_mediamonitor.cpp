@@ -21,7 +21,9 @@
 #include <QColor>
 #include <QStringList>
 
+#include "media-collection.h"
 #include "media-monitor.h"
+#include "media-source.h"
 
 class tst_MediaMonitor : public QObject
 {
@@ -30,6 +32,9 @@ class tst_MediaMonitor : public QObject
 private slots:
     void initTestCase();
     void tst_scanning_sub_folders();
+    void tst_moved_file();
+    void tst_moved_directory();
+    void tst_removed_directory();
     void cleanupTestCase();
 
 private:
@@ -92,6 +97,122 @@ void tst_MediaMonitor::tst_scanning_sub_folders()
     QTRY_COMPARE_WITH_TIMEOUT(m_monitor->manifest().count(), 8, 10000);
 }
 
+void tst_MediaMonitor::tst_moved_file()
+{
+    QTemporaryDir tmpDir;
+    QDir dir(tmpDir.path());
+    dir.mkpath("A");
+    dir.mkpath("B");
+    m_sampleImage->save(tmpDir.path() + "/A/sample.jpg", "JPG");
+
+    MediaCollection collection(0);
+    MediaSource *media = new MediaSource(QFileInfo(tmpDir.path() + "/A/sample.jpg"));
+    media->setId(7);
+    collection.add(media);
+
+    MediaMonitor monitor;
+    QSignalSpy spyMoved(&monitor, SIGNAL(mediaItemMoved(qint64, QString)));
+    QSignalSpy spyAdded(&monitor, SIGNAL(mediaItemAdded(QString, int)));
+    QSignalSpy spyRemoved(&monitor, SIGNAL(mediaItemRemoved(qint64)));
+
+    monitor.startMonitoring(QStringList(tmpDir.path()), QStringList());
+    monitor.checkConsistency(&collection);
+    QTRY_COMPARE_WITH_TIMEOUT(monitor.manifest().count(), 1, 10000);
+
+    QVERIFY(QFile::rename(tmpDir.path() + "/A/sample.jpg", tmpDir.path() + "/B/moved.jpg"));
+
+    QTRY_COMPARE_WITH_TIMEOUT(spyMoved.count(), 1, 10000);
+    QList<QVariant> args = spyMoved.takeFirst();
+    QCOMPARE(args.at(0).toLongLong(), (qint64)7);
+    QCOMPARE(args.at(1).toString(), tmpDir.path() + "/B/moved.jpg");
+    QCOMPARE(spyAdded.count(), 0);
+    QCOMPARE(spyRemoved.count(), 0);
+}
+
+void tst_MediaMonitor::tst_moved_directory()
+{
+    QTemporaryDir tmpDir;
+    QDir dir(tmpDir.path());
+    dir.mkpath("trip/day1");
+    m_sampleImage->save(tmpDir.path() + "/trip/sample.jpg", "JPG");
+    m_sampleImage->save(tmpDir.path() + "/trip/day1/sample.jpg", "JPG");
+
+    MediaCollection collection(0);
+    MediaSource *media = new MediaSource(QFileInfo(tmpDir.path() + "/trip/sample.jpg"));
+    media->setId(7);
+    collection.add(media);
+    media = new MediaSource(QFileInfo(tmpDir.path() + "/trip/day1/sample.jpg"));
+    media->setId(8);
+    collection.add(media);
+
+    MediaMonitor monitor;
+    QSignalSpy spyMoved(&monitor, SIGNAL(mediaItemMoved(qint64, QString)));
+    QSignalSpy spyAdded(&monitor, SIGNAL(mediaItemAdded(QString, int)));
+    QSignalSpy spyRemoved(&monitor, SIGNAL(mediaItemRemoved(qint64)));
+
+    monitor.startMonitoring(QStringList(tmpDir.path()), QStringList());
+    monitor.checkConsistency(&collection);
+    QTRY_COMPARE_WITH_TIMEOUT(monitor.manifest().count(), 2, 10000);
+
+    // Only the parent of the moved directory reports the change
+    QVERIFY(dir.rename("trip", "holidays"));
+
+    QTRY_COMPARE_WITH_TIMEOUT(spyMoved.count(), 2, 10000);
+    QStringList newPaths;
+    newPaths << spyMoved.at(0).at(1).toString() << spyMoved.at(1).at(1).toString();
+    newPaths.sort();
+    QCOMPARE(newPaths.at(0), tmpDir.path() + "/holidays/day1/sample.jpg");
+    QCOMPARE(newPaths.at(1), tmpDir.path() + "/holidays/sample.jpg");
+    QCOMPARE(spyAdded.count(), 0);
+    QCOMPARE(spyRemoved.count(), 0);
+
+    QStringList manifest = monitor.manifest();
+    manifest.sort();
+    QCOMPARE(manifest, newPaths);
+}
+
+void tst_MediaMonitor::tst_removed_directory()
+{
+    QTemporaryDir tmpDir;
+    QTemporaryDir outsideDir;
+    QDir dir(tmpDir.path());
+    dir.mkpath("trip/day1");
+    m_sampleImage->save(tmpDir.path() + "/trip/sample.jpg", "JPG");
+    m_sampleImage->save(tmpDir.path() + "/trip/day1/sample.jpg", "JPG");
+
+    MediaCollection collection(0);
+    MediaSource *media = new MediaSource(QFileInfo(tmpDir.path() + "/trip/sample.jpg"));
+    media->setId(7);
+    collection.add(media);
+    media = new MediaSource(QFileInfo(tmpDir.path() + "/trip/day1/sample.jpg"));
+    media->setId(8);
+    collection.add(media);
+
+    MediaMonitor monitor;
+    QSignalSpy spyAdded(&monitor, SIGNAL(mediaItemAdded(QString, int)));
+    QSignalSpy spyRemoved(&monitor, SIGNAL(mediaItemRemoved(qint64)));
+
+    monitor.startMonitoring(QStringList(tmpDir.path()), QStringList());
+    monitor.checkConsistency(&collection);
+    QTRY_COMPARE_WITH_TIMEOUT(monitor.manifest().count(), 2, 10000);
+
+    QVERIFY(QFile::rename(tmpDir.path() + "/trip", outsideDir.path() + "/trip"));
+
+    QTRY_COMPARE_WITH_TIMEOUT(spyRemoved.count(), 2, 10000);
+    QList<qint64> removedIds;
+    removedIds << spyRemoved.at(0).at(0).toLongLong() << spyRemoved.at(1).at(0).toLongLong();
+    qSort(removedIds);
+    QCOMPARE(removedIds, QList<qint64>() << 7 << 8);
+    QCOMPARE(spyAdded.count(), 0);
+    QCOMPARE(monitor.manifest().count(), 0);
+
+    // A re-created directory is watched again
+    dir.mkpath("trip/day1");
+    m_sampleImage->save(tmpDir.path() + "/trip/day1/new.jpg", "JPG");
+    QTRY_COMPARE_WITH_TIMEOUT(monitor.manifest(),
+                              QStringList(tmpDir.path() + "/trip/day1/new.jpg"), 10000);
+}
+
 void tst_MediaMonitor::cleanupTestCase()
 {
     //Remove the previously created files
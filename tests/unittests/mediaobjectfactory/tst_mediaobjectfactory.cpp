@@ -15,6 +15,7 @@
  */
 
 #include <QtTest/QtTest>
+#include <QBuffer>
 #include <QString>
 #include <QDir>
 #include <QTemporaryDir>
@@ -45,9 +46,13 @@ private slots:
     void clearMetadata();
     void readPhotoMetadata();
     void readVideoMetadata();
+    void readPlaceholderColor();
     void enableContentLoadFilter();
     void addPhoto();
+    void addModifiedPhoto();
     void addVideo();
+    void movedPhoto();
+    void copiedPhoto();
 
 private:
     MediaSource* wait_for_media();
@@ -136,6 +141,7 @@ void tst_MediaObjectFactory::clearMetadata()
     m_factory->m_size = QSize(1, 1);
     m_factory->m_orientation = BOTTOM_RIGHT_ORIGIN;
     m_factory->m_fileSize = 999;
+    m_factory->m_placeholderColor = QColor(Qt::red);
 
     m_factory->clearMetadata();
 
@@ -144,6 +150,7 @@ void tst_MediaObjectFactory::clearMetadata()
     QCOMPARE(m_factory->m_size, QSize());
     QCOMPARE(m_factory->m_orientation, TOP_LEFT_ORIGIN);
     QCOMPARE(m_factory->m_fileSize, (qint64)0);
+    QVERIFY(!m_factory->m_placeholderColor.isValid());
 }
 
 void tst_MediaObjectFactory::readPhotoMetadata()
@@ -163,6 +170,27 @@ void tst_MediaObjectFactory::readVideoMetadata()
     QCOMPARE(success, false);
 }
 
+void tst_MediaObjectFactory::readPlaceholderColor()
+{
+    m_factory->readPlaceholderColor(QByteArray());
+    QVERIFY(!m_factory->m_placeholderColor.isValid());
+
+    // Left half dark, right half bright, like an Exif thumbnail
+    QImage thumbnail(160, 120, QImage::Format_RGB32);
+    thumbnail.fill(QColor(20, 20, 20));
+    for (int y = 0; y < thumbnail.height(); y++) {
+        for (int x = thumbnail.width() / 2; x < thumbnail.width(); x++)
+            thumbnail.setPixel(x, y, qRgb(220, 220, 220));
+    }
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(thumbnail.save(&buffer, "JPG", 100));
+
+    m_factory->readPlaceholderColor(data);
+    QVERIFY(qAbs(m_factory->m_placeholderColor.value() - 120) <= 4);
+}
+
 void tst_MediaObjectFactory::enableContentLoadFilter()
 {
     m_factory->create(SAMPLE_DATA_DIR "/sample01.jpg");
@@ -188,13 +216,14 @@ void tst_MediaObjectFactory::addPhoto()
     qint64 id = 123;
     QString filename(tmpDir->path() + "/sample/sample.jpg");
     QSize size(320, 200);
-    QDateTime timestamp(QDate(2013, 02, 03), QTime(12, 12, 12));
+    QDateTime timestamp(QFileInfo(filename).lastModified());
     QDateTime exposureTime(QDate(2013, 03, 04), QTime(1, 2, 3));
     Orientation originalOrientation(BOTTOM_RIGHT_ORIGIN);
-    qint64 filesize = 2048;
+    qint64 filesize = QFileInfo(filename).size();
+    QColor placeholderColor(Qt::red);
 
     m_factory->addMedia(id, filename, size, timestamp,
-                        exposureTime, originalOrientation, filesize);
+                        exposureTime, originalOrientation, filesize, placeholderColor);
 
     QCOMPARE(m_factory->m_mediaFromDB.size(), 1);
     
@@ -210,6 +239,54 @@ void tst_MediaObjectFactory::addPhoto()
     QCOMPARE(photo->exposureDateTime(), exposureTime);
     QCOMPARE(photo->fileTimestamp(), timestamp);
     QCOMPARE(photo->orientation(), originalOrientation);
+    QCOMPARE(photo->placeholderColor(), placeholderColor);
+}
+
+void tst_MediaObjectFactory::addModifiedPhoto()
+{
+    QTemporaryDir *tmpDir = new QTemporaryDir();
+    QDir *dir = new QDir(tmpDir->path());
+    dir->mkpath("sample");
+
+    // Create sample image
+    QImage *sampleImage = new QImage(400, 600, QImage::Format_RGB32);
+    sampleImage->fill(QColor(Qt::red));
+    sampleImage->save(tmpDir->path() + "/sample/sample.jpg", "JPG");
+
+    // The stored fingerprint doesn't match the file anymore
+    QString filename(tmpDir->path() + "/sample/sample.jpg");
+    QSize size(320, 200);
+    QDateTime timestamp(QDate(2013, 02, 03), QTime(12, 12, 12));
+    QDateTime exposureTime(QDate(2013, 03, 04), QTime(1, 2, 3));
+    Orientation originalOrientation(BOTTOM_RIGHT_ORIGIN);
+    qint64 filesize = 2048;
+    qint64 id = m_mediaTable->createIdForMedia(filename, timestamp, exposureTime,
+                                               originalOrientation, filesize, size,
+                                               MediaSource::Photo);
+
+    m_factory->addMedia(id, filename, size, timestamp,
+                        exposureTime, originalOrientation, filesize, QColor());
+
+    QCOMPARE(m_factory->m_mediaFromDB.size(), 1);
+
+    Photo *photo = qobject_cast<Photo*>(*m_factory->m_mediaFromDB.begin());
+    QVERIFY(photo != 0);
+
+    // Same row, but the metadata got read again from the file
+    QCOMPARE(photo->id(), id);
+    QCOMPARE(photo->exposureDateTime(), QDateTime(QDate(2013, 01, 01), QTime(11, 11, 11)));
+    QCOMPARE(photo->fileTimestamp(), QFileInfo(filename).lastModified());
+    QCOMPARE(photo->orientation(), BOTTOM_LEFT_ORIGIN);
+
+    QSize rowSize;
+    Orientation rowOrientation;
+    QDateTime rowTimestamp;
+    QDateTime rowExposureTime;
+    qint64 rowFilesize;
+    m_mediaTable->getRow(id, rowSize, rowOrientation, rowTimestamp, rowExposureTime,
+                         rowFilesize);
+    QCOMPARE(rowOrientation, BOTTOM_LEFT_ORIGIN);
+    QCOMPARE(rowFilesize, QFileInfo(filename).size());
 }
 
 void tst_MediaObjectFactory::addVideo()
@@ -226,13 +303,13 @@ void tst_MediaObjectFactory::addVideo()
     qint64 id = 123;
     QString filename(tmpDir->path() + "/sample/sample.mp4");
     QSize size(320, 200);
-    QDateTime timestamp(QDate(2013, 02, 03), QTime(12, 12, 12));
+    QDateTime timestamp(QFileInfo(filename).created());
     QDateTime exposureTime(QDate(2013, 03, 04), QTime(1, 2, 3));
     Orientation originalOrientation(BOTTOM_RIGHT_ORIGIN);
-    qint64 filesize = 2048;
+    qint64 filesize = QFileInfo(filename).size();
 
     m_factory->addMedia(id, filename, size, timestamp,
-                        exposureTime, originalOrientation, filesize);
+                        exposureTime, originalOrientation, filesize, QColor());
 
     QCOMPARE(m_factory->m_mediaFromDB.size(), 1);
     
@@ -248,6 +325,67 @@ void tst_MediaObjectFactory::addVideo()
     QCOMPARE(video->exposureDateTime(), exposureTime);
 }
 
+void tst_MediaObjectFactory::movedPhoto()
+{
+    QTemporaryDir tmpDir;
+    QString oldFilename(tmpDir.path() + "/old.jpg");
+    QString newFilename(tmpDir.path() + "/new.jpg");
+    QVERIFY(QFile::copy(SAMPLE_DATA_DIR "/sample01.jpg", oldFilename));
+
+    m_factory->create(oldFilename);
+    Photo *photo = qobject_cast<Photo*>(wait_for_media());
+    QVERIFY(photo != 0);
+    qint64 id = photo->id();
+    m_mediaTable->setPlaceholderColor(id, QColor(Qt::blue));
+
+    // Moved while the app was not running
+    QVERIFY(QFile::rename(oldFilename, newFilename));
+    m_factory->addMedia(id, oldFilename, QSize(), QFileInfo(newFilename).lastModified(),
+                        photo->exposureDateTime(), photo->orientation(),
+                        QFileInfo(newFilename).size(), QColor());
+    QCOMPARE(m_factory->m_mediaFromDB.size(), 0);
+    QVERIFY(m_factory->m_missingMedia.contains(id));
+
+    // The row of the old file is taken over
+    m_factory->create(newFilename);
+    photo = qobject_cast<Photo*>(wait_for_media());
+    QVERIFY(photo != 0);
+    QCOMPARE(photo->id(), id);
+    QCOMPARE(photo->path().toLocalFile(), newFilename);
+    QCOMPARE(photo->exposureDateTime(), QDateTime(QDate(2013, 01, 01), QTime(11, 11, 11)));
+    QCOMPARE(photo->placeholderColor(), QColor(Qt::blue));
+    QCOMPARE(m_mediaTable->getIdForMedia(newFilename), id);
+    QCOMPARE(m_mediaTable->getIdForMedia(oldFilename), (qint64)-1);
+    QVERIFY(m_factory->m_missingMedia.isEmpty());
+}
+
+void tst_MediaObjectFactory::copiedPhoto()
+{
+    QTemporaryDir tmpDir;
+    QString filename(tmpDir.path() + "/photo.jpg");
+    QString copyFilename(tmpDir.path() + "/copy.jpg");
+    QVERIFY(QFile::copy(SAMPLE_DATA_DIR "/sample01.jpg", filename));
+    QVERIFY(QFile::copy(SAMPLE_DATA_DIR "/sample01.jpg", copyFilename));
+
+    m_factory->create(filename);
+    Photo *photo = qobject_cast<Photo*>(wait_for_media());
+    QVERIFY(photo != 0);
+    qint64 id = photo->id();
+    m_mediaTable->setPlaceholderColor(id, QColor(Qt::blue));
+
+    // The copy gets its own row, with the metadata of the original
+    m_factory->create(copyFilename);
+    photo = qobject_cast<Photo*>(wait_for_media());
+    QVERIFY(photo != 0);
+    QVERIFY(photo->id() != id);
+    QCOMPARE(photo->path().toLocalFile(), copyFilename);
+    QCOMPARE(photo->exposureDateTime(), QDateTime(QDate(2013, 01, 01), QTime(11, 11, 11)));
+    QCOMPARE(photo->orientation(), BOTTOM_LEFT_ORIGIN);
+    QCOMPARE(photo->placeholderColor(), QColor(Qt::blue));
+    QCOMPARE(m_mediaTable->getPlaceholderColor(photo->id()), QColor(Qt::blue));
+    QCOMPARE(m_mediaTable->getIdForMedia(filename), id);
+}
+
 MediaSource* tst_MediaObjectFactory::wait_for_media()
 {
     if (m_spyMediaObjectCreated->isEmpty())
@@ -16,14 +16,25 @@
 
 #include <QtTest/QtTest>
 
+#include "photo/exif-reader.h"
 #include "photo/photo-metadata.h"
 
+#include <QBuffer>
+#include <QDataStream>
+#include <QImageReader>
+#include <QTemporaryFile>
+
 class tst_PhotoMetadata : public QObject
 {
   Q_OBJECT
 
 private slots:
     void exposureTime();
+    void exifReader();
+    void exifReaderLittleEndian();
+    void exifReaderNoJpeg();
+    void exifReaderRaw();
+    void writeOrientation();
 
 private:
     PhotoMetadata *m_metadata;
@@ -41,6 +52,211 @@ void tst_PhotoMetadata::exposureTime()
     QCOMPARE(m_metadata->exposureTime(), QDateTime(QDate(2015, 12, 31), QTime(23, 59, 59)));
 }
 
+void tst_PhotoMetadata::exifReader()
+{
+    QString fileName(SAMPLE_IMAGE_DIR "/sample01.jpg");
+    ExifReader reader(fileName);
+    QVERIFY(reader.read());
+
+    // Has to match what Exiv2 and Qt read from the same file
+    PhotoMetadata *metadata = PhotoMetadata::fromFile(fileName.toUtf8().constData());
+    QCOMPARE(reader.exposureTime(), metadata->exposureTime());
+    QCOMPARE(reader.exposureTime(), QDateTime(QDate(2015, 5, 8), QTime(1, 51, 48)));
+    QCOMPARE(reader.orientation(), metadata->orientation());
+    QCOMPARE(reader.size(), QImageReader(fileName).size());
+    QCOMPARE(reader.size(), QSize(1836, 3264));
+    delete metadata;
+}
+
+void tst_PhotoMetadata::exifReaderLittleEndian()
+{
+    // TIFF structure in Intel byte order: IFD0 with the orientation and the
+    // pointer to the Exif IFD, which has the date and the pixel dimensions
+    QByteArray tiff;
+    QDataStream tiffStream(&tiff, QIODevice::WriteOnly);
+    tiffStream.setByteOrder(QDataStream::LittleEndian);
+    tiffStream.writeRawData("II", 2);
+    tiffStream << quint16(42) << quint32(8);
+    // IFD0
+    tiffStream << quint16(2);
+    tiffStream << quint16(0x0112) << quint16(3) << quint32(1) << quint16(RIGHT_TOP_ORIGIN) << quint16(0);
+    tiffStream << quint16(0x8769) << quint16(4) << quint32(1) << quint32(38);
+    tiffStream << quint32(0);
+    // Exif IFD
+    tiffStream << quint16(3);
+    tiffStream << quint16(0x9003) << quint16(2) << quint32(20) << quint32(80);
+    tiffStream << quint16(0xA002) << quint16(3) << quint32(1) << quint16(640) << quint16(0);
+    tiffStream << quint16(0xA003) << quint16(4) << quint32(1) << quint32(480);
+    tiffStream << quint32(0);
+    tiffStream.writeRawData("2013:01:02 03:04:05", 20);
+
+    QByteArray jpeg;
+    QDataStream jpegStream(&jpeg, QIODevice::WriteOnly);
+    jpegStream << quint16(0xFFD8);
+    jpegStream << quint16(0xFFE1) << quint16(2 + 6 + tiff.size());
+    jpegStream.writeRawData("Exif\0\0", 6);
+    jpegStream.writeRawData(tiff.constData(), tiff.size());
+    jpegStream << quint16(0xFFD9);
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(jpeg);
+    file.close();
+
+    ExifReader reader(file.fileName());
+    QVERIFY(reader.read());
+    QCOMPARE(reader.exposureTime(), QDateTime(QDate(2013, 1, 2), QTime(3, 4, 5)));
+    QCOMPARE(reader.orientation(), RIGHT_TOP_ORIGIN);
+    QCOMPARE(reader.size(), QSize(640, 480));
+}
+
+void tst_PhotoMetadata::exifReaderNoJpeg()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write("GIF89a");
+    file.close();
+
+    ExifReader reader(file.fileName());
+    QVERIFY(!reader.read());
+    QVERIFY(!reader.exposureTime().isValid());
+    QCOMPARE(reader.orientation(), TOP_LEFT_ORIGIN);
+}
+
+void tst_PhotoMetadata::exifReaderRaw()
+{
+    QByteArray small;
+    QBuffer smallBuffer(&small);
+    smallBuffer.open(QIODevice::WriteOnly);
+    QVERIFY(QImage(16, 8, QImage::Format_RGB32).save(&smallBuffer, "JPG"));
+
+    QByteArray big;
+    QBuffer bigBuffer(&big);
+    bigBuffer.open(QIODevice::WriteOnly);
+    QVERIFY(QImage(64, 32, QImage::Format_RGB32).save(&bigBuffer, "JPG"));
+
+    // Frame header of a lossless JPEG image, like the sensor data is stored in
+    QByteArray lossless;
+    QDataStream losslessStream(&lossless, QIODevice::WriteOnly);
+    losslessStream << quint16(0xFFD8) << quint16(0xFFC3) << quint16(11) << quint8(8)
+                   << quint16(256) << quint16(512) << quint8(1) << quint8(1) << quint8(0x11)
+                   << quint8(0) << quint16(0xFFD9);
+
+    // IFD0 with the orientation and the small preview, and two SubIFDs with
+    // the big preview and the sensor data
+    const quint32 subIfdsOffset = 62;
+    const quint32 dataOffset = 154;
+    QByteArray raw;
+    QDataStream stream(&raw, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData("II", 2);
+    stream << quint16(42) << quint32(8);
+    // IFD0
+    stream << quint16(4);
+    stream << quint16(0x0112) << quint16(3) << quint32(1) << quint16(LEFT_BOTTOM_ORIGIN) << quint16(0);
+    stream << quint16(0x014A) << quint16(4) << quint32(2) << subIfdsOffset;
+    stream << quint16(0x0201) << quint16(4) << quint32(1) << dataOffset;
+    stream << quint16(0x0202) << quint16(4) << quint32(1) << quint32(small.size());
+    stream << quint32(0);
+    // SubIFD offsets
+    stream << quint32(70) << quint32(112);
+    // SubIFD with the big preview
+    stream << quint16(3);
+    stream << quint16(0x0103) << quint16(3) << quint32(1) << quint16(7) << quint16(0);
+    stream << quint16(0x0111) << quint16(4) << quint32(1) << quint32(dataOffset + small.size());
+    stream << quint16(0x0117) << quint16(4) << quint32(1) << quint32(big.size());
+    stream << quint32(0);
+    // SubIFD with the sensor data
+    stream << quint16(3);
+    stream << quint16(0x0103) << quint16(3) << quint32(1) << quint16(7) << quint16(0);
+    stream << quint16(0x0111) << quint16(4) << quint32(1)
+           << quint32(dataOffset + small.size() + big.size());
+    stream << quint16(0x0117) << quint16(4) << quint32(1) << quint32(lossless.size());
+    stream << quint32(0);
+    QCOMPARE(raw.size(), int(dataOffset));
+    raw += small + big + lossless;
+
+    QTemporaryFile file(QDir::tempPath() + "/rawXXXXXX.dng");
+    QVERIFY(file.open());
+    file.write(raw);
+    file.close();
+
+    QVERIFY(ExifReader::isRawFile(QFileInfo(file.fileName())));
+    QVERIFY(!ExifReader::isRawFile(QFileInfo("photo.tiff")));
+
+    ExifReader reader(file.fileName());
+    QVERIFY(reader.readRaw());
+    QCOMPARE(reader.orientation(), LEFT_BOTTOM_ORIGIN);
+    QCOMPARE(reader.size(), QSize(64, 32));
+    QCOMPARE(reader.preview(), big);
+
+    // Without any JPEG preview, there is nothing to show
+    raw.truncate(dataOffset);
+    raw += lossless;
+    QVERIFY(file.open());
+    file.resize(0);
+    file.write(raw);
+    file.close();
+
+    ExifReader noPreview(file.fileName());
+    QVERIFY(!noPreview.readRaw());
+    QVERIFY(noPreview.preview().isEmpty());
+}
+
+void tst_PhotoMetadata::writeOrientation()
+{
+    // IFD0 in Motorola byte order, with the orientation only
+    QByteArray tiff;
+    QDataStream tiffStream(&tiff, QIODevice::WriteOnly);
+    tiffStream.writeRawData("MM", 2);
+    tiffStream << quint16(42) << quint32(8);
+    tiffStream << quint16(1);
+    tiffStream << quint16(0x0112) << quint16(3) << quint32(1) << quint16(TOP_LEFT_ORIGIN) << quint16(0);
+    tiffStream << quint32(0);
+
+    QByteArray jpeg;
+    QDataStream jpegStream(&jpeg, QIODevice::WriteOnly);
+    jpegStream << quint16(0xFFD8);
+    jpegStream << quint16(0xFFE1) << quint16(2 + 6 + tiff.size());
+    jpegStream.writeRawData("Exif\0\0", 6);
+    jpegStream.writeRawData(tiff.constData(), tiff.size());
+    jpegStream << quint16(0xFFD9);
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(jpeg);
+    file.close();
+
+    // The tag exists, so only its value changes
+    QVERIFY(PhotoMetadata::writeOrientation(QFileInfo(file.fileName()), RIGHT_TOP_ORIGIN));
+    QVERIFY(file.open());
+    QByteArray patched = file.readAll();
+    file.close();
+    QCOMPARE(patched.size(), jpeg.size());
+    QCOMPARE(patched.left(31), jpeg.left(31));
+    QCOMPARE(patched.at(31), char(RIGHT_TOP_ORIGIN));
+    QCOMPARE(patched.mid(32), jpeg.mid(32));
+
+    ExifReader reader(file.fileName());
+    QVERIFY(reader.read());
+    QCOMPARE(reader.orientation(), RIGHT_TOP_ORIGIN);
+
+    // Without the tag, Exiv2 has to add it
+    QTemporaryFile noExif(QDir::tempPath() + "/photoXXXXXX.jpg");
+    QVERIFY(noExif.open());
+    QVERIFY(QImage(16, 8, QImage::Format_RGB32).save(&noExif, "JPG"));
+    noExif.close();
+
+    ExifReader noTag(noExif.fileName());
+    QVERIFY(noTag.read());
+    QVERIFY(!noTag.writeOrientation(BOTTOM_RIGHT_ORIGIN));
+
+    QVERIFY(PhotoMetadata::writeOrientation(QFileInfo(noExif.fileName()), BOTTOM_RIGHT_ORIGIN));
+    ExifReader added(noExif.fileName());
+    QVERIFY(added.read());
+    QCOMPARE(added.orientation(), BOTTOM_RIGHT_ORIGIN);
+}
+
 QTEST_MAIN(tst_PhotoMetadata);
 
 #include "tst_photo-metadata.moc"
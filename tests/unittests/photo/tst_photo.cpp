@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2013 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QThreadPool>
+
+#include "exif-reader.h"
+#include "media-table.h"
+#include "photo.h"
+
+class tst_Photo : public QObject
+{
+  Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void rotate();
+    void rotateFailed();
+
+private:
+    Orientation storedOrientation(qint64 id);
+
+    QTemporaryDir *m_dir;
+    QString m_fileName;
+    MediaTable *m_mediaTable;
+};
+
+void tst_Photo::init()
+{
+    m_dir = new QTemporaryDir;
+    m_fileName = m_dir->path() + "/sample01.jpg";
+    QVERIFY(QFile::copy(SAMPLE_IMAGE_DIR "/sample01.jpg", m_fileName));
+    QVERIFY(QFile::setPermissions(m_fileName, QFile::ReadOwner | QFile::WriteOwner));
+    m_mediaTable = new MediaTable(0, 0);
+}
+
+void tst_Photo::cleanup()
+{
+    delete m_mediaTable;
+    m_mediaTable = 0;
+    delete m_dir;
+    m_dir = 0;
+}
+
+Orientation tst_Photo::storedOrientation(qint64 id)
+{
+    QSize size;
+    Orientation orientation = TOP_LEFT_ORIGIN;
+    QDateTime timestamp;
+    QDateTime exposureTime;
+    qint64 fileSize;
+    m_mediaTable->getRow(id, size, orientation, timestamp, exposureTime, fileSize);
+    return orientation;
+}
+
+void tst_Photo::rotate()
+{
+    ExifReader original(m_fileName);
+    QVERIFY(original.read());
+
+    Photo photo((QFileInfo(m_fileName)));
+    photo.setOriginalOrientation(original.orientation());
+    qint64 id = m_mediaTable->createIdForMedia(m_fileName, QDateTime(), QDateTime(),
+                                               original.orientation(), 0, QSize(),
+                                               MediaSource::Photo);
+    photo.setId(id);
+    photo.setMediaTable(m_mediaTable);
+
+    // Rotations in quick succession have to end up in the file in order
+    Orientation expected = original.orientation();
+    for (int i = 0; i < 5; i++) {
+        photo.rotateRight();
+        expected = OrientationCorrection::rotateOrientation(expected, false);
+    }
+    photo.rotateLeft();
+    expected = OrientationCorrection::rotateOrientation(expected, true);
+
+    // Shown and stored right away
+    QCOMPARE(photo.originalOrientation(), expected);
+    QCOMPARE(storedOrientation(id), expected);
+
+    QThreadPool::globalInstance()->waitForDone();
+    ExifReader written(m_fileName);
+    QVERIFY(written.read());
+    QCOMPARE(written.orientation(), expected);
+
+    QTest::qWait(100);
+    QCOMPARE(photo.originalOrientation(), expected);
+}
+
+void tst_Photo::rotateFailed()
+{
+    ExifReader original(m_fileName);
+    QVERIFY(original.read());
+
+    Photo photo((QFileInfo(m_fileName)));
+    photo.setOriginalOrientation(original.orientation());
+    qint64 id = m_mediaTable->createIdForMedia(m_fileName, QDateTime(), QDateTime(),
+                                               original.orientation(), 0, QSize(),
+                                               MediaSource::Photo);
+    photo.setId(id);
+    photo.setMediaTable(m_mediaTable);
+
+    // Neither the orientation can be patched, nor the file rewritten
+    QVERIFY(QFile::remove(m_fileName));
+
+    photo.rotateRight();
+    photo.rotateRight();
+    QCOMPARE(photo.originalOrientation(),
+             OrientationCorrection::rotateOrientation(
+                 OrientationCorrection::rotateOrientation(original.orientation(), false), false));
+
+    QThreadPool::globalInstance()->waitForDone();
+    QTRY_COMPARE(photo.originalOrientation(), original.orientation());
+    QCOMPARE(storedOrientation(id), original.orientation());
+}
+
+QTEST_MAIN(tst_Photo);
+
+#include "tst_photo.moc"
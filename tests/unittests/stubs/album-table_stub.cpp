@@ -30,9 +30,10 @@ AlbumTable::AlbumTable(Database* db, QObject* parent)
 {
 }
 
-void AlbumTable::getAlbums(QList<Album*>* albumSet)
+void AlbumTable::getAlbums(QList<Album*>* albumSet, QHash<qint64, QVector<qint64> >* albumMedia)
 {
     Q_UNUSED(albumSet);
+    Q_UNUSED(albumMedia);
 }
 
 void AlbumTable::addAlbum(Album* album)
@@ -45,22 +46,16 @@ void AlbumTable::removeAlbum(Album* album)
     Q_UNUSED(album);
 }
 
-void AlbumTable::attachToAlbum(qint64 albumId, qint64 mediaId)
+void AlbumTable::attachMany(qint64 albumId, const QList<qint64>& mediaIds)
 {
     Q_UNUSED(albumId);
-    Q_UNUSED(mediaId);
+    Q_UNUSED(mediaIds);
 }
 
-void AlbumTable::detachFromAlbum(qint64 albumId, qint64 mediaId)
+void AlbumTable::detachMany(qint64 albumId, const QList<qint64>& mediaIds)
 {
     Q_UNUSED(albumId);
-    Q_UNUSED(mediaId);
-}
-
-void AlbumTable::mediaForAlbum(qint64 albumId, QList<qint64>* list) const
-{
-    Q_UNUSED(albumId);
-    Q_UNUSED(list);
+    Q_UNUSED(mediaIds);
 }
 
 void AlbumTable::setIsClosed(qint64 albumId, bool isClosed)
@@ -50,3 +50,20 @@ MediaTable* Database::getMediaTable() const
 {
     return m_mediaTable;
 }
+
+void Database::closeThreadConnection()
+{
+}
+
+void Database::scheduleCheckpoint()
+{
+}
+
+void Database::onIdleTimeout()
+{
+}
+
+void Database::onBackupFinished(bool success)
+{
+    Q_UNUSED(success);
+}
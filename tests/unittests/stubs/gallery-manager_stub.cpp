@@ -38,6 +38,7 @@ GalleryManager* GalleryManager::m_galleryManager = NULL;
 GalleryManager::GalleryManager(bool desktopMode, const QString& picturesDir)
     : collectionsInitialised(false),
       m_resource(0),
+      m_thumbnailCache(0),
       m_database(0),
       m_defaultTemplate(0),
       m_mediaCollection(0),
@@ -100,6 +101,21 @@ void GalleryManager::onMediaItemRemoved(qint64 mediaId)
     Q_UNUSED(mediaId);
 }
 
+void GalleryManager::onMediaItemChanged(QString file)
+{
+    Q_UNUSED(file);
+}
+
+void GalleryManager::onMediaItemMoved(qint64 mediaId, QString file)
+{
+    Q_UNUSED(mediaId);
+    Q_UNUSED(file);
+}
+
+void GalleryManager::onConsistencyCheckFinished()
+{
+}
+
 void GalleryManager::onMediaObjectCreated(MediaSource *mediaObject)
 {
     Q_UNUSED(mediaObject);
@@ -36,6 +36,8 @@ public:
     qint64 filesize;
     int width;
     int height;
+    QByteArray contentHash;
+    QColor placeholderColor;
 };
 
 static qint64 mediaLastId = 0;
@@ -65,7 +67,8 @@ qint64 MediaTable::getIdForMedia(const QString& filename)
 
 qint64 MediaTable::createIdForMedia(const QString& filename,
                                        const QDateTime& timestamp, const QDateTime& exposureTime,
-                                       Orientation originalOrientation, qint64 filesize, QSize size)
+                                       Orientation originalOrientation, qint64 filesize, QSize size,
+                                       MediaSource::MediaType mediaType)
 {
     MediaDataRow row;
     row.id = mediaLastId;
@@ -85,7 +88,8 @@ void MediaTable::updateMedia(qint64 mediaId, const QString& filename,
                               const QDateTime& timestamp, const QDateTime& exposureTime,
                               Orientation originalOrientation, qint64 filesize)
 {
-    foreach (MediaDataRow row, mediaFakeTable) {
+    for (int i = 0; i < mediaFakeTable.size(); ++i) {
+        MediaDataRow &row = mediaFakeTable[i];
         if (row.id == mediaId) {
             row.filename = filename;
             row.timestamp = timestamp;
@@ -101,6 +105,65 @@ void MediaTable::remove(qint64 mediaId)
 {
 }
 
+void MediaTable::setFilename(qint64 mediaId, const QString& filename)
+{
+    for (int i = 0; i < mediaFakeTable.size(); ++i) {
+        if (mediaFakeTable[i].id == mediaId) {
+            mediaFakeTable[i].filename = filename;
+            return;
+        }
+    }
+}
+
+void MediaTable::setContentHash(qint64 mediaId, const QByteArray& contentHash)
+{
+    for (int i = 0; i < mediaFakeTable.size(); ++i) {
+        if (mediaFakeTable[i].id == mediaId) {
+            mediaFakeTable[i].contentHash = contentHash;
+            return;
+        }
+    }
+}
+
+QHash<qint64, QString> MediaTable::getMediaWithContentHash(const QByteArray& contentHash)
+{
+    QHash<qint64, QString> media;
+    foreach (const MediaDataRow &row, mediaFakeTable) {
+        if (row.contentHash == contentHash)
+            media.insert(row.id, row.filename);
+    }
+    return media;
+}
+
+void MediaTable::setPlaceholderColor(qint64 mediaId, const QColor& placeholderColor)
+{
+    for (int i = 0; i < mediaFakeTable.size(); ++i) {
+        if (mediaFakeTable[i].id == mediaId) {
+            mediaFakeTable[i].placeholderColor = placeholderColor;
+            return;
+        }
+    }
+}
+
+QColor MediaTable::getPlaceholderColor(qint64 mediaId)
+{
+    foreach (const MediaDataRow &row, mediaFakeTable) {
+        if (row.id == mediaId)
+            return row.placeholderColor;
+    }
+    return QColor();
+}
+
+void MediaTable::setOriginalOrientation(qint64 mediaId, const Orientation& orientation)
+{
+    for (int i = 0; i < mediaFakeTable.size(); ++i) {
+        if (mediaFakeTable[i].id == mediaId) {
+            mediaFakeTable[i].originalOrientation = orientation;
+            return;
+        }
+    }
+}
+
 QSize MediaTable::getMediaSize(qint64 mediaId)
 {
     return QSize();
@@ -110,18 +173,20 @@ void MediaTable::setMediaSize(qint64 mediaId, const QSize& size)
 {
 }
 
-void MediaTable::emitAllRows()
+void MediaTable::emitAllRows(MediaSource::MediaType mediaType)
 {
 }
 
 void MediaTable::getRow(qint64 mediaId, QSize& size, Orientation& 
-                         originalOrientation, QDateTime& fileTimestamp, QDateTime& exposureDateTime)
+                         originalOrientation, QDateTime& fileTimestamp, QDateTime& exposureDateTime,
+                         qint64& filesize)
 {
     foreach (MediaDataRow row, mediaFakeTable) {
         if (row.id == mediaId) {
             fileTimestamp = row.timestamp;
             exposureDateTime = row.exposureTime;
             originalOrientation = row.originalOrientation;
+            filesize = row.filesize;
             return;
         }
     }
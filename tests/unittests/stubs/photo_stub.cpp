@@ -62,6 +62,11 @@ bool Photo::canBeEdited() const
     return true;
 }
 
+bool Photo::isRaw() const
+{
+    return false;
+}
+
 void Photo::destroySource(bool destroyBacking, bool asOrphan)
 {
 }
@@ -70,3 +75,26 @@ void Photo::setOriginalOrientation(Orientation orientation)
 {
     m_originalOrientation = orientation;
 }
+
+void Photo::rotateLeft()
+{
+}
+
+void Photo::rotateRight()
+{
+}
+
+void Photo::onOrientationWriteFailed(int orientation)
+{
+}
+
+OrientationWriter::OrientationWriter(const QString& path, Orientation writtenOrientation)
+    : QObject(),
+      m_path(path),
+      m_writtenOrientation(writtenOrientation)
+{
+}
+
+void OrientationWriter::run()
+{
+}
@@ -46,6 +46,19 @@ PhotoMetadata* PhotoMetadata::fromFile(const QFileInfo &file)
     }
 }
 
+QDateTime PhotoMetadata::parseExifDateTime(const QByteArray &value)
+{
+    Q_UNUSED(value);
+    return QDateTime();
+}
+
+bool PhotoMetadata::writeOrientation(const QFileInfo& file, Orientation orientation)
+{
+    Q_UNUSED(file);
+    Q_UNUSED(orientation);
+    return true;
+}
+
 QDateTime PhotoMetadata::exposureTime() const
 {
     return QDateTime(QDate(2013, 01, 01), QTime(11, 11, 11));
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2013 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <QTemporaryDir>
+
+#include "thumbnail-cache.h"
+#include "thumbnail-store.h"
+
+class tst_ThumbnailCache : public QObject
+{
+  Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void levelForSize_data();
+    void levelForSize();
+    void jpegDecodeSize_data();
+    void jpegDecodeSize();
+    void readImageScaled();
+    void readImageBenchmark_data();
+    void readImageBenchmark();
+    void thumbnail();
+    void changedPhoto();
+    void cleanUp();
+    void storeReopen();
+    void storeGrow();
+    void storeCompact();
+    void storeEvict();
+    void storeInvalidIndex();
+
+private:
+    QTemporaryDir *m_photoDir;
+    QTemporaryDir *m_cacheDir;
+    QString m_photo;
+};
+
+void tst_ThumbnailCache::init()
+{
+    m_photoDir = new QTemporaryDir;
+    m_cacheDir = new QTemporaryDir;
+
+    m_photo = m_photoDir->path() + "/photo.jpg";
+    QImage image(1000, 500, QImage::Format_RGB32);
+    image.fill(Qt::red);
+    QVERIFY(image.save(m_photo));
+}
+
+void tst_ThumbnailCache::cleanup()
+{
+    delete m_cacheDir;
+    delete m_photoDir;
+}
+
+void tst_ThumbnailCache::levelForSize_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("level");
+
+    QTest::newRow("small") << QSize(100, 100) << int(ThumbnailCache::Small);
+    QTest::newRow("exact") << QSize(128, 128) << int(ThumbnailCache::Small);
+    QTest::newRow("width only") << QSize(200, 0) << int(ThumbnailCache::Medium);
+    QTest::newRow("height only") << QSize(-1, 300) << int(ThumbnailCache::Large);
+    QTest::newRow("too big") << QSize(600, 600) << int(ThumbnailCache::LevelCount);
+    QTest::newRow("no size") << QSize() << int(ThumbnailCache::LevelCount);
+}
+
+void tst_ThumbnailCache::levelForSize()
+{
+    QFETCH(QSize, size);
+    QFETCH(int, level);
+
+    QCOMPARE(int(ThumbnailCache::levelForSize(size)), level);
+}
+
+void tst_ThumbnailCache::jpegDecodeSize_data()
+{
+    QTest::addColumn<QSize>("imageSize");
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<QSize>("decodeSize");
+
+    QTest::newRow("1/8") << QSize(4000, 3000) << QSize(256, 192) << QSize(500, 375);
+    QTest::newRow("1/4") << QSize(4000, 3000) << QSize(512, 384) << QSize(1000, 750);
+    QTest::newRow("1/2") << QSize(4000, 3000) << QSize(1024, 768) << QSize(2000, 1500);
+    QTest::newRow("full") << QSize(1000, 500) << QSize(600, 300) << QSize(1000, 500);
+    QTest::newRow("odd size") << QSize(1015, 763) << QSize(126, 95) << QSize(127, 96);
+    QTest::newRow("rounded up") << QSize(1836, 3264) << QSize(216, 384) << QSize(230, 408);
+    QTest::newRow("height limits") << QSize(4000, 1000) << QSize(512, 128) << QSize(1000, 250);
+}
+
+void tst_ThumbnailCache::jpegDecodeSize()
+{
+    QFETCH(QSize, imageSize);
+    QFETCH(QSize, size);
+    QFETCH(QSize, decodeSize);
+
+    QCOMPARE(ThumbnailCache::jpegDecodeSize(imageSize, size), decodeSize);
+}
+
+void tst_ThumbnailCache::readImageScaled()
+{
+    QString fileName = m_photoDir->path() + "/big.jpg";
+    QImage image(4000, 3000, QImage::Format_RGB32);
+    image.fill(Qt::green);
+    QVERIFY(image.save(fileName));
+
+    QImage scaled = ThumbnailCache::readImage(QFileInfo(fileName), QSize(256, 256));
+    QCOMPARE(scaled.size(), QSize(341, 256));
+    QCOMPARE(QColor(scaled.pixel(170, 128)).green() > 200, true);
+
+    scaled = ThumbnailCache::readImage(QFileInfo(fileName), QSize(0, 1000));
+    QCOMPARE(scaled.size(), QSize(1333, 1000));
+}
+
+void tst_ThumbnailCache::readImageBenchmark_data()
+{
+    QTest::addColumn<bool>("scaledDecoding");
+
+    QTest::newRow("full decoding") << false;
+    QTest::newRow("scaled decoding") << true;
+}
+
+void tst_ThumbnailCache::readImageBenchmark()
+{
+    QFETCH(bool, scaledDecoding);
+
+    // About the size of the photos of a phone camera
+    QString fileName = m_photoDir->path() + "/big.jpg";
+    QImage image(5312, 2988, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); y++) {
+        QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); x++)
+            line[x] = qRgb(x % 256, y % 256, (x + y) % 256);
+    }
+    QVERIFY(image.save(fileName));
+
+    QImage thumbnail;
+    QBENCHMARK {
+        if (scaledDecoding) {
+            thumbnail = ThumbnailCache::readImage(QFileInfo(fileName), QSize(256, 256));
+        } else {
+            thumbnail = QImage(fileName).scaled(QSize(256, 256), Qt::KeepAspectRatioByExpanding,
+                                                Qt::SmoothTransformation);
+        }
+    }
+    QCOMPARE(thumbnail.height(), 256);
+}
+
+void tst_ThumbnailCache::thumbnail()
+{
+    {
+        ThumbnailCache cache(m_cacheDir->path());
+
+        QImage thumbnail = cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Small);
+        QCOMPARE(thumbnail.size(), QSize(256, 128));
+        QCOMPARE(cache.m_store.count(), 1);
+
+        thumbnail = cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Medium);
+        QCOMPARE(thumbnail.size(), QSize(512, 256));
+        QCOMPARE(cache.m_store.count(), 2);
+
+        // Replace the stored thumbnail, to see that it gets read from the store
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(QImage(10, 10, QImage::Format_RGB32).save(&buffer, "JPG"));
+        cache.m_store.insert(cache.key(QFileInfo(m_photo)), ThumbnailCache::Small, data);
+    }
+
+    ThumbnailCache cache(m_cacheDir->path());
+    QImage thumbnail = cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Small);
+    QCOMPARE(thumbnail.size(), QSize(10, 10));
+    QCOMPARE(cache.m_store.count(), 2);
+
+    // Photos smaller than the level are not scaled up
+    thumbnail = cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Large);
+    QCOMPARE(thumbnail.size(), QSize(1000, 500));
+}
+
+void tst_ThumbnailCache::changedPhoto()
+{
+    ThumbnailCache cache(m_cacheDir->path());
+
+    QImage thumbnail = cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Small);
+    QCOMPARE(thumbnail.size(), QSize(256, 128));
+
+    // A new modification time makes it a different photo
+    QTest::qWait(1100);
+    QImage image(500, 1000, QImage::Format_RGB32);
+    image.fill(Qt::blue);
+    QVERIFY(image.save(m_photo));
+
+    thumbnail = cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Small);
+    QCOMPARE(thumbnail.size(), QSize(128, 256));
+    QCOMPARE(cache.m_store.count(), 2);
+}
+
+void tst_ThumbnailCache::cleanUp()
+{
+    ThumbnailCache cache(m_cacheDir->path());
+    cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Small);
+    cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Medium);
+    cache.thumbnail(QFileInfo(m_photo), ThumbnailCache::Large);
+    QCOMPARE(cache.m_store.count(), 3);
+
+    // Everything fits, nothing to remove
+    while (cache.cleanUp()) { }
+    QCOMPARE(cache.m_store.count(), 3);
+
+    cache.setDiskBudget(0);
+    while (cache.cleanUp()) { }
+    QCOMPARE(cache.m_store.count(), 0);
+}
+
+void tst_ThumbnailCache::storeReopen()
+{
+    {
+        ThumbnailStore store(m_cacheDir->path());
+        store.insert(42, 0, "small");
+        store.insert(42, 1, "medium");
+        store.insert(0, 0, "zero");
+        store.insert(42, 0, "replaced");
+        QCOMPARE(store.count(), 3);
+    }
+
+    ThumbnailStore store(m_cacheDir->path());
+    QCOMPARE(store.count(), 3);
+    QCOMPARE(store.find(42, 0), QByteArray("replaced"));
+    QCOMPARE(store.find(42, 1), QByteArray("medium"));
+    QCOMPARE(store.find(0, 0), QByteArray("zero"));
+    QVERIFY(store.find(42, 2).isEmpty());
+    QVERIFY(store.find(43, 0).isEmpty());
+}
+
+void tst_ThumbnailCache::storeGrow()
+{
+    ThumbnailStore store(m_cacheDir->path());
+    for (quint64 key = 0; key < 5000; key++)
+        store.insert(key * 4096, 0, QByteArray::number(key));
+    QCOMPARE(store.count(), 5000);
+
+    for (quint64 key = 0; key < 5000; key++)
+        QCOMPARE(store.find(key * 4096, 0), QByteArray::number(key));
+}
+
+void tst_ThumbnailCache::storeCompact()
+{
+    ThumbnailStore store(m_cacheDir->path());
+    store.m_maxPackSize = 1000;
+
+    QByteArray data(400, 'a');
+    store.insert(2, 0, data);
+    store.insert(3, 0, data);
+    store.insert(4, 0, data);
+    QCOMPARE(store.size(), qint64(1200));
+
+    // Two thirds of the first pack become dead space
+    QByteArray newData(400, 'b');
+    store.insert(2, 0, newData);
+    store.insert(3, 0, newData);
+    QCOMPARE(store.size(), qint64(2000));
+
+    while (store.cleanUp(1024 * 1024)) { }
+    QCOMPARE(store.size(), qint64(1200));
+    QCOMPARE(store.count(), 3);
+    QCOMPARE(store.find(2, 0), newData);
+    QCOMPARE(store.find(3, 0), newData);
+    QCOMPARE(store.find(4, 0), data);
+    QVERIFY(!QFile::exists(m_cacheDir->path() + "/thumbnails-0.pack"));
+
+    // The least recently used thumbnail is evicted first
+    QTest::qWait(1100);
+    store.find(2, 0);
+    store.find(3, 0);
+    while (store.cleanUp(800)) { }
+    QCOMPARE(store.count(), 2);
+    QVERIFY(store.find(4, 0).isEmpty());
+}
+
+void tst_ThumbnailCache::storeEvict()
+{
+    QByteArray data(10, 'a');
+    {
+        ThumbnailStore store(m_cacheDir->path());
+        for (quint64 key = 2; key < 122; key++)
+            store.insert(key, 0, data);
+
+        // Used after the others, which is kept when reopened
+        QTest::qWait(1100);
+        QCOMPARE(store.find(2, 0), data);
+    }
+
+    ThumbnailStore store(m_cacheDir->path());
+    QCOMPARE(store.count(), 120);
+
+    // One step removes a batch only
+    QVERIFY(store.cleanUp(100));
+    QCOMPARE(store.count(), 70);
+
+    while (store.cleanUp(100)) { }
+    QCOMPARE(store.count(), 10);
+    QCOMPARE(store.find(2, 0), data);
+}
+
+void tst_ThumbnailCache::storeInvalidIndex()
+{
+    {
+        ThumbnailStore store(m_cacheDir->path());
+        store.insert(42, 0, "data");
+    }
+
+    QFile index(m_cacheDir->path() + "/thumbnails.index");
+    QVERIFY(index.open(QIODevice::WriteOnly));
+    index.write("garbage");
+    index.close();
+
+    ThumbnailStore store(m_cacheDir->path());
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.size(), qint64(0));
+    QVERIFY(store.find(42, 0).isEmpty());
+}
+
+QTEST_MAIN(tst_ThumbnailCache);
+
+#include "tst_thumbnail-cache.moc"